@@ -0,0 +1,146 @@
+/*************************************************************************
+ * Batch.cpp
+ *
+ * This file contains the class implementation for the batch runner.
+ *
+ * This code was developed as a demonstration for SER450 and is provided
+ * as-is as a learning aid for Chapter 4 of the class text.
+ *
+ * COPYRIGHT (C) 2019, Arizona State University
+ * ALL RIGHTS RESERVED
+ *
+ **************************************************************************/
+#include <stdio.h>
+#include <string.h>
+#include <sstream>
+#include "Batch.h"
+#include "MappedFile.h"
+#include "Parallel.h"
+#include "ProgramImage.h"
+#include "RegisterFile.h"
+
+// the name of a halt status in the results
+static const char *statusName(Cpu::halt_status status)
+{
+    switch (status)
+    {
+    case Cpu::HALT_SELF_LOOP:
+        return "self_loop";
+    case Cpu::HALT_BREAK:
+        return "break";
+    case Cpu::HALT_PREDICATE:
+        return "predicate";
+    default:
+        return "cycle_limit";
+    }
+}
+
+// write a string as a JSON string literal
+static void writeString(std::ostream &out, const std::string &text)
+{
+    out << '"';
+    for (unsigned int i = 0; i < text.size(); i++)
+    {
+        unsigned char c = text[i];
+        if ((c == '"') || (c == '\\'))
+            out << '\\' << c;
+        else if (c < 0x20)
+        {
+            char escaped[8];
+            snprintf(escaped, sizeof(escaped), "\\u%04x", c);
+            out << escaped;
+        }
+        else
+            out << c;
+    }
+    out << '"';
+}
+
+//********************************************
+// loadManifest
+bool Batch::loadManifest(const char *filename)
+{
+    MappedFile manifest;
+    if (!manifest.open(filename))
+        return false;
+    const char *p = (const char *)manifest.data();
+    const char *end = p + manifest.size();
+    while (p < end)
+    {
+        const char *eol = (const char *)memchr(p, '\n', end - p);
+        if (!eol)
+            eol = end;
+        std::istringstream line(std::string(p, eol));
+        p = eol + 1;
+
+        std::string program;
+        if (!(line >> program) || (program[0] == '#'))
+            continue;
+        unsigned long long cycles;
+        std::string rest;
+        if (!(line >> cycles) || (line >> rest))
+            return false;
+        addJob(program, cycles);
+    }
+    return true;
+}
+
+void Batch::addJob(const std::string &program, unsigned long long cycles)
+{
+    job work = {program, cycles};
+    jobs.push_back(work);
+}
+
+//********************************************
+// runJob
+// Each job loads its own program image, so jobs
+// share nothing and can run on any thread.
+Batch::job_result Batch::runJob(const job &work)
+{
+    job_result result = {};
+    ProgramImage image;
+    if (!image.load(work.program.c_str()))
+        return result;
+    result.loaded = true;
+
+    DataMemory dmem;
+    RegisterFile regs;
+    Cpu cpu(image, dmem, regs);
+    Cpu::run_result run = cpu.run(work.cycles);
+    result.status = run.status;
+    result.cycles = run.cycles;
+    result.events = cpu.getEvents();
+    memcpy(result.regs, regs.data(), sizeof(result.regs));
+    return result;
+}
+
+//********************************************
+// run
+void Batch::run(unsigned int threads)
+{
+    results.assign(jobs.size(), job_result());
+    parallelFor(jobs.size(), threads, [&](unsigned int i) { results[i] = runJob(jobs[i]); });
+}
+
+//********************************************
+// writeResults
+void Batch::writeResults(std::ostream &out) const
+{
+    for (unsigned int i = 0; i < results.size(); i++)
+    {
+        const job_result &result = results[i];
+        out << "{\"job\":" << i << ",\"program\":";
+        writeString(out, jobs[i].program);
+        out << ",\"loaded\":" << (result.loaded ? "true" : "false");
+        if (result.loaded)
+        {
+            out << ",\"status\":\"" << statusName(result.status) << "\",\"counters\":";
+            Cpu::writeCounters(out, result.events, result.cycles);
+            out << ",\"regs\":[";
+            for (unsigned int r = 0; r < 32; r++)
+                out << (r ? "," : "") << result.regs[r];
+            out << "]";
+        }
+        out << "}\n";
+    }
+}
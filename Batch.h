@@ -0,0 +1,66 @@
+/*************************************************************************
+ * Batch.h
+ *
+ * This file contains the class definition for the batch runner.  A batch
+ * is a list of jobs, each a program and a cycle budget, read from a
+ * manifest.  The jobs are independent, so each runs on its own Cpu, data
+ * memory and register file, and the jobs are spread over a pool of host
+ * threads.  The result of each job is written as one line of JSON.
+ *
+ * This code was developed as a demonstration for SER450 and is provided
+ * as-is as a learning aid for Chapter 4 of the class text.
+ *
+ * COPYRIGHT (C) 2019, Arizona State University
+ * ALL RIGHTS RESERVED
+ *
+ **************************************************************************/
+#ifndef BATCH_H
+#define BATCH_H
+#include <ostream>
+#include <string>
+#include <vector>
+#include "Cpu.h"
+
+class Batch
+{
+public:
+    typedef struct
+    {
+        std::string program;       // a text program or binary image
+        unsigned long long cycles; // the most cycles to simulate
+    } job;
+
+    typedef struct
+    {
+        bool loaded;                // false if the program couldn't be loaded
+        Cpu::halt_status status;    // HALT_NONE if the budget ran out
+        unsigned long long cycles;  // cycles simulated
+        Cpu::event_counters events;
+        unsigned int regs[32];      // the final register file
+    } job_result;
+
+    // Read the jobs from a manifest.  Each line holds a program filename
+    // and a cycle budget separated by white space; blank lines and lines
+    // starting with '#' are ignored.  Returns false if the manifest can't
+    // be read or a line can't be understood.
+    bool loadManifest(const char *filename);
+    void addJob(const std::string &program, unsigned long long cycles);
+
+    // run every job on up to threads threads (0 for one per core)
+    void run(unsigned int threads = 0);
+
+    // write one line of JSON for each job, in manifest order, with its
+    // counters in the form Cpu::writeCounters writes them
+    void writeResults(std::ostream &out) const;
+
+    const std::vector<job> &getJobs() const { return jobs; }
+    const std::vector<job_result> &getResults() const { return results; }
+
+private:
+    std::vector<job> jobs;
+    std::vector<job_result> results;
+
+    static job_result runJob(const job &work);
+};
+
+#endif // BATCH_H
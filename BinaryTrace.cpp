@@ -0,0 +1,452 @@
+/*************************************************************************
+ * BinaryTrace.cpp
+ *
+ * This file contains the class implementations for the binary pipeline
+ * trace.
+ *
+ * This code was developed as a demonstration for SER450 and is provided
+ * as-is as a learning aid for Chapter 4 of the class text.
+ *
+ * COPYRIGHT (C) 2019, Arizona State University
+ * ALL RIGHTS RESERVED
+ *
+ **************************************************************************/
+#include <string.h>
+#include "BinaryTrace.h"
+#include "RegisterFile.h"
+#include "TraceSink.h"
+
+#define TRACE_MAGIC 0x43525450 // "PTRC" on a little-endian host
+#define TRACE_VERSION 1
+#define TRACE_BLOCK_MAGIC 0x4b4c4254 // "TBLK"
+
+typedef struct
+{
+    unsigned int magic;
+    unsigned int version;
+    unsigned int reserved[2];
+} trace_header;
+
+typedef struct
+{
+    unsigned int magic;
+    unsigned int length;  // bytes of records that follow
+    unsigned int records; // the number of cycles in the block
+    unsigned int reserved;
+    unsigned long long firstCycle;
+} trace_block;
+
+static_assert(sizeof(trace_header) == 16, "trace header layout");
+static_assert(sizeof(trace_block) == 24, "trace block layout");
+
+static inline unsigned int zigzag(int value)
+{
+    return ((unsigned int)value << 1) ^ (unsigned int)(value >> 31);
+}
+
+static inline int unzigzag(unsigned int value)
+{
+    return (int)(value >> 1) ^ -(int)(value & 1);
+}
+
+static inline unsigned int ifSlot(unsigned int pc)
+{
+    return (pc >> 2) & 1023;
+}
+
+//********************************************
+// traceEventName
+const char *traceEventName(unsigned int event)
+{
+    switch (event)
+    {
+    case TRACE_EVENT_MEM_TO_EQUALITY_RS:
+        return "Forwarding RS from MEM to Equality Unit";
+    case TRACE_EVENT_MEM_TO_EQUALITY_RT:
+        return "Forwarding RT from MEM to Equality Unit";
+    case TRACE_EVENT_MEM_TO_ALU_A:
+        return "Forwarding RS from MEM to ALU input";
+    case TRACE_EVENT_MEM_TO_ALU_B:
+        return "Forwarding RT from MEM to ALU input";
+    case TRACE_EVENT_WB_TO_ALU_A:
+        return "Forwarding RS from WB to ALU input";
+    case TRACE_EVENT_WB_TO_ALU_B:
+        return "Forwarding RT from WB to ALU input";
+    case TRACE_EVENT_LOAD_USE_STALL:
+        return "Stall for a load result";
+    case TRACE_EVENT_BRANCH_STALL:
+        return "Stall for a branch operand";
+    default:
+        return "Unknown event";
+    }
+}
+
+//********************************************
+// dumpTraceCycle
+void dumpTraceCycle(const trace_cycle &cycle, TraceSink &sink)
+{
+    sink << "Clock Cycle: " << cycle.cycle << "\n";
+
+    sink << "PIPELINE\n";
+    sink << "IF:  ";
+    sink.hex(cycle.stages[TRACE_STAGE_IF]) << " (PC = ";
+    sink.hex(cycle.pc) << ")\n";
+    sink << "ID:  ";
+    sink.hex(cycle.stages[TRACE_STAGE_ID]) << "\n";
+    sink << "EXE: ";
+    sink.hex(cycle.stages[TRACE_STAGE_EXE]) << "\n";
+    sink << "MEM: ";
+    sink.hex(cycle.stages[TRACE_STAGE_MEM]) << "\n";
+    sink << "WB:  ";
+    sink.hex(cycle.stages[TRACE_STAGE_WB]) << "\n";
+
+    sink << "REGISTER FILE\n";
+    RegisterFile::dump(cycle.regs, sink);
+    sink << "\n";
+}
+
+//********************************************
+// BinaryTraceWriter
+BinaryTraceWriter::BinaryTraceWriter()
+    : out(0), failed(false), blockCycles(65536), blockRecords(0), blockFirstCycle(0)
+{
+}
+
+BinaryTraceWriter::~BinaryTraceWriter()
+{
+    close();
+}
+
+bool BinaryTraceWriter::open(const char *filename, unsigned int blockCycles)
+{
+    close();
+    out = fopen(filename, "wb");
+    if (!out)
+        return false;
+    failed = false;
+    this->blockCycles = blockCycles ? blockCycles : 1;
+    blockRecords = 0;
+    trace_header header = {TRACE_MAGIC, TRACE_VERSION, {0, 0}};
+    failed = fwrite(&header, sizeof(header), 1, out) != 1;
+    return !failed;
+}
+
+bool BinaryTraceWriter::close()
+{
+    if (!out)
+        return !failed;
+    endBlock();
+    if (fclose(out) != 0)
+        failed = true;
+    out = 0;
+    return !failed;
+}
+
+void BinaryTraceWriter::put(unsigned long long value)
+{
+    while (value >= 0x80)
+    {
+        block.push_back((unsigned char)(value | 0x80));
+        value >>= 7;
+    }
+    block.push_back((unsigned char)value);
+}
+
+//********************************************
+// endBlock
+// write out the block that has been built up
+void BinaryTraceWriter::endBlock()
+{
+    if (blockRecords == 0)
+        return;
+    trace_block header = {TRACE_BLOCK_MAGIC, (unsigned int)block.size(), blockRecords, 0, blockFirstCycle};
+    if ((fwrite(&header, sizeof(header), 1, out) != 1) || (fwrite(block.data(), 1, block.size(), out) != block.size()))
+        failed = true;
+    block.clear();
+    blockRecords = 0;
+}
+
+//********************************************
+// record
+void BinaryTraceWriter::record(const trace_cycle &cycle)
+{
+    if (!out)
+        return;
+
+    // a cycle that doesn't follow the previous one (the Cpu was restored
+    // from a checkpoint, for example) starts a new block
+    if ((blockRecords != 0) && (cycle.cycle <= previous.cycle))
+        endBlock();
+
+    if (blockRecords == 0)
+    {
+        blockFirstCycle = cycle.cycle;
+        memset(ifCacheValid, 0, sizeof(ifCacheValid));
+        block.push_back(TRACE_FULL | (cycle.events ? TRACE_EVENTS : 0));
+        put(cycle.cycle);
+        put(cycle.pc);
+        for (unsigned int i = 0; i < 5; i++)
+            put(cycle.stages[i]);
+        for (unsigned int i = 0; i < 32; i++)
+            put(cycle.regs[i]);
+        if (cycle.events)
+            put(cycle.events);
+    }
+    else
+    {
+        // work out what differs from the prediction
+        unsigned char flags = 0;
+        unsigned long long gap = cycle.cycle - previous.cycle - 1;
+        if (gap)
+            flags |= TRACE_CYCLE;
+        unsigned int pcDelta = cycle.pc - (previous.pc + 4);
+        if (pcDelta)
+            flags |= TRACE_PC;
+        unsigned int slot = ifSlot(cycle.pc);
+        if (!(ifCacheValid[slot] && (ifCache[slot][0] == cycle.pc) && (ifCache[slot][1] == cycle.stages[TRACE_STAGE_IF])))
+            flags |= TRACE_IF;
+        unsigned char stageMask = 0;
+        for (unsigned int i = 1; i < 5; i++)
+            if (cycle.stages[i] != previous.stages[i - 1])
+                stageMask |= 1 << (i - 1);
+        if (stageMask)
+            flags |= TRACE_STAGES;
+        if (cycle.events)
+            flags |= TRACE_EVENTS;
+        unsigned int changed = 0;
+        for (unsigned int i = 0; i < 32; i++)
+            if (cycle.regs[i] != previous.regs[i])
+                changed++;
+        if (changed)
+            flags |= TRACE_REGS;
+
+        block.push_back(flags);
+        if (gap)
+            put(gap);
+        if (pcDelta)
+            put(zigzag((int)pcDelta));
+        if (flags & TRACE_IF)
+            put(cycle.stages[TRACE_STAGE_IF]);
+        if (stageMask)
+        {
+            block.push_back(stageMask);
+            for (unsigned int i = 1; i < 5; i++)
+                if (stageMask & (1 << (i - 1)))
+                    put(cycle.stages[i]);
+        }
+        if (cycle.events)
+            put(cycle.events);
+        if (changed)
+        {
+            block.push_back((unsigned char)changed);
+            for (unsigned int i = 0; i < 32; i++)
+            {
+                if (cycle.regs[i] == previous.regs[i])
+                    continue;
+                block.push_back((unsigned char)i);
+                put(zigzag((int)(cycle.regs[i] - previous.regs[i])));
+            }
+        }
+    }
+
+    unsigned int slot = ifSlot(cycle.pc);
+    ifCache[slot][0] = cycle.pc;
+    ifCache[slot][1] = cycle.stages[TRACE_STAGE_IF];
+    ifCacheValid[slot] = 1;
+    previous = cycle;
+    if (++blockRecords == blockCycles)
+        endBlock();
+}
+
+//********************************************
+// BinaryTraceReader
+BinaryTraceReader::BinaryTraceReader()
+    : nextBlock(0)
+{
+}
+
+//********************************************
+// open
+// A block that runs past the end of the file (from a
+// trace that was cut short) is ignored.
+bool BinaryTraceReader::open(const char *filename)
+{
+    blocks.clear();
+    nextBlock = 0;
+    sequential = Decoder();
+    if (!file.open(filename))
+        return false;
+    const unsigned char *p = file.data();
+    const unsigned char *end = p + file.size();
+    trace_header header;
+    if (file.size() < sizeof(header))
+        return false;
+    memcpy(&header, p, sizeof(header));
+    if ((header.magic != TRACE_MAGIC) || (header.version != TRACE_VERSION))
+        return false;
+    p += sizeof(header);
+
+    while ((size_t)(end - p) >= sizeof(trace_block))
+    {
+        trace_block block;
+        memcpy(&block, p, sizeof(block));
+        if ((block.magic != TRACE_BLOCK_MAGIC) || (block.length > (size_t)(end - p) - sizeof(block)))
+            break;
+        blocks.push_back(p);
+        p += sizeof(block) + block.length;
+    }
+    return true;
+}
+
+unsigned long long BinaryTraceReader::blockFirstCycle(unsigned int block) const
+{
+    trace_block header;
+    memcpy(&header, blocks[block], sizeof(header));
+    return header.firstCycle;
+}
+
+const unsigned char *BinaryTraceReader::blockData(unsigned int block, unsigned int &length) const
+{
+    trace_block header;
+    memcpy(&header, blocks[block], sizeof(header));
+    length = header.length;
+    return blocks[block] + sizeof(header);
+}
+
+void BinaryTraceReader::decodeBlock(unsigned int block, Decoder &decoder) const
+{
+    trace_block header;
+    memcpy(&header, blocks[block], sizeof(header));
+    decoder.p = blocks[block] + sizeof(header);
+    decoder.end = decoder.p + header.length;
+    memset(decoder.ifCacheValid, 0, sizeof(decoder.ifCacheValid));
+}
+
+bool BinaryTraceReader::next(trace_cycle &cycle)
+{
+    while (!sequential.next(cycle))
+    {
+        if (nextBlock >= blocks.size())
+            return false;
+        decodeBlock(nextBlock++, sequential);
+    }
+    return true;
+}
+
+//********************************************
+// Decoder
+bool BinaryTraceReader::Decoder::get(unsigned long long &value)
+{
+    value = 0;
+    for (unsigned int shift = 0; (p < end) && (shift < 64); shift += 7)
+    {
+        unsigned char byte = *p++;
+        value |= (unsigned long long)(byte & 0x7f) << shift;
+        if (!(byte & 0x80))
+            return true;
+    }
+    return false;
+}
+
+bool BinaryTraceReader::Decoder::next(trace_cycle &cycle)
+{
+    if (p >= end)
+        return false;
+    unsigned char flags = *p++;
+    unsigned long long value;
+    state.events = 0;
+    state.changedRegs = 0;
+
+    if (flags & TRACE_FULL)
+    {
+        if (!get(state.cycle) || !get(value))
+            return false;
+        state.pc = value;
+        for (unsigned int i = 0; i < 5; i++)
+        {
+            if (!get(value))
+                return false;
+            state.stages[i] = value;
+        }
+        for (unsigned int i = 0; i < 32; i++)
+        {
+            if (!get(value))
+                return false;
+            state.regs[i] = value;
+        }
+    }
+    else
+    {
+        unsigned long long gap = 0;
+        if ((flags & TRACE_CYCLE) && !get(gap))
+            return false;
+        state.cycle += 1 + gap;
+        unsigned int pc = state.pc + 4;
+        if (flags & TRACE_PC)
+        {
+            if (!get(value))
+                return false;
+            pc += unzigzag(value);
+        }
+        state.pc = pc;
+
+        // the other stages move on, then any exceptions are applied
+        for (unsigned int i = 4; i > 0; i--)
+            state.stages[i] = state.stages[i - 1];
+        unsigned int slot = ifSlot(pc);
+        if (flags & TRACE_IF)
+        {
+            if (!get(value))
+                return false;
+            state.stages[TRACE_STAGE_IF] = value;
+        }
+        else if (ifCacheValid[slot] && (ifCache[slot][0] == pc))
+            state.stages[TRACE_STAGE_IF] = ifCache[slot][1];
+        else
+            return false;
+        if (flags & TRACE_STAGES)
+        {
+            if (p >= end)
+                return false;
+            unsigned char stageMask = *p++;
+            for (unsigned int i = 1; i < 5; i++)
+            {
+                if (!(stageMask & (1 << (i - 1))))
+                    continue;
+                if (!get(value))
+                    return false;
+                state.stages[i] = value;
+            }
+        }
+    }
+
+    if (flags & TRACE_EVENTS)
+    {
+        if (!get(value))
+            return false;
+        state.events = value;
+    }
+    if ((flags & TRACE_REGS) && !(flags & TRACE_FULL))
+    {
+        if (p >= end)
+            return false;
+        unsigned int count = *p++;
+        for (unsigned int i = 0; i < count; i++)
+        {
+            if (p >= end)
+                return false;
+            unsigned int r = *p++ & 31;
+            if (!get(value))
+                return false;
+            state.regs[r] += unzigzag(value);
+            state.changedRegs |= 1u << r;
+        }
+    }
+
+    unsigned int slot = ifSlot(state.pc);
+    ifCache[slot][0] = state.pc;
+    ifCache[slot][1] = state.stages[TRACE_STAGE_IF];
+    ifCacheValid[slot] = 1;
+    cycle = state;
+    return true;
+}
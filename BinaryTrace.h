@@ -0,0 +1,163 @@
+/*************************************************************************
+ * BinaryTrace.h
+ *
+ * This file contains the class definitions for the binary pipeline trace.
+ * A trace records, for every clock cycle, what Cpu::dump shows: the pc
+ * and the instruction in each pipeline stage, plus the forwarding and
+ * stall events of the cycle and the registers that changed.  Each cycle
+ * is stored as the difference from the one before, which for straight
+ * pipeline flow is usually a single byte.
+ *
+ * File layout (host byte order):
+ *
+ *   trace_header
+ *   blocks, each a trace_block header followed by its records
+ *
+ * Every block starts with a full record, so blocks can be decoded on
+ * their own (and in parallel).  A record starts with a byte of TRACE_xxx
+ * flags saying which fields follow; numbers are LEB128 varints, and
+ * signed differences are zigzag encoded first.
+ *
+ *   TRACE_FULL    cycle, pc, the five stage instructions, the 32
+ *                 registers, then events if TRACE_EVENTS is set
+ *   otherwise, in this order, when the flag is set:
+ *   TRACE_CYCLE   cycles skipped since the previous record (normally 1 apart)
+ *   TRACE_PC      pc - (previous pc + 4)
+ *   TRACE_IF      the IF instruction; otherwise it is the instruction last
+ *                 seen at this pc in the block
+ *   TRACE_STAGES  a byte with a bit for each of ID, EXE, MEM and WB whose
+ *                 instruction follows; the rest moved on from the
+ *                 previous stage
+ *   TRACE_EVENTS  the TRACE_EVENT_xxx bits
+ *   TRACE_REGS    a count byte, then register number and the change in
+ *                 its value for each register that changed
+ *
+ * This code was developed as a demonstration for SER450 and is provided
+ * as-is as a learning aid for Chapter 4 of the class text.
+ *
+ * COPYRIGHT (C) 2019, Arizona State University
+ * ALL RIGHTS RESERVED
+ *
+ **************************************************************************/
+#ifndef BINARYTRACE_H
+#define BINARYTRACE_H
+#include <stdio.h>
+#include <vector>
+#include "MappedFile.h"
+
+class TraceSink;
+
+// record flags
+#define TRACE_PC 0x01
+#define TRACE_STAGES 0x02
+#define TRACE_EVENTS 0x04
+#define TRACE_REGS 0x08
+#define TRACE_CYCLE 0x10
+#define TRACE_IF 0x20
+#define TRACE_FULL 0x40
+
+// the events of a cycle
+#define TRACE_EVENT_MEM_TO_EQUALITY_RS 0x01
+#define TRACE_EVENT_MEM_TO_EQUALITY_RT 0x02
+#define TRACE_EVENT_MEM_TO_ALU_A 0x04
+#define TRACE_EVENT_MEM_TO_ALU_B 0x08
+#define TRACE_EVENT_WB_TO_ALU_A 0x10
+#define TRACE_EVENT_WB_TO_ALU_B 0x20
+#define TRACE_EVENT_LOAD_USE_STALL 0x40
+#define TRACE_EVENT_BRANCH_STALL 0x80
+#define TRACE_EVENT_COUNT 8
+
+// the pipeline stages, in the order of trace_cycle::stages
+#define TRACE_STAGE_IF 0
+#define TRACE_STAGE_ID 1
+#define TRACE_STAGE_EXE 2
+#define TRACE_STAGE_MEM 3
+#define TRACE_STAGE_WB 4
+
+// the state of the machine at the end of a clock cycle
+typedef struct
+{
+    unsigned long long cycle;  // the clock cycle count, as Cpu::dump shows it
+    unsigned int pc;           // the address of the instruction in IF
+    unsigned int stages[5];    // the instruction in each stage
+    unsigned int events;       // TRACE_EVENT_xxx bits
+    unsigned int regs[32];
+    unsigned int changedRegs;  // a bit for each register that changed this cycle
+} trace_cycle;
+
+// the message for an event, as the forwarding log prints it
+const char *traceEventName(unsigned int event);
+
+// print a cycle in the format of Cpu::dump
+void dumpTraceCycle(const trace_cycle &cycle, TraceSink &sink);
+
+class BinaryTraceWriter
+{
+public:
+    BinaryTraceWriter();
+    ~BinaryTraceWriter(); // closes the trace
+
+    // start a trace file, with a new block every blockCycles records
+    bool open(const char *filename, unsigned int blockCycles = 65536);
+    void record(const trace_cycle &cycle);
+    bool close(); // returns false if anything couldn't be written
+
+private:
+    FILE *out;
+    bool failed;
+    unsigned int blockCycles;
+    std::vector<unsigned char> block; // the records of the current block
+    unsigned int blockRecords;
+    unsigned long long blockFirstCycle;
+    trace_cycle previous;
+    unsigned int ifCache[1024][2]; // (pc, instruction) seen in this block
+    unsigned char ifCacheValid[1024];
+
+    void put(unsigned long long value); // as a varint
+    void endBlock();
+};
+
+class BinaryTraceReader
+{
+public:
+    BinaryTraceReader();
+
+    // open a trace file, returning false if it isn't one
+    bool open(const char *filename);
+
+    // the blocks of the trace, each of which can be decoded on its own
+    unsigned int blockCount() const { return blocks.size(); }
+    unsigned long long blockFirstCycle(unsigned int block) const;
+    const unsigned char *blockData(unsigned int block, unsigned int &length) const; // the encoded records
+
+    // decoding.  A decoder is positioned at the start of a block and then
+    // returns the block's cycles in order; decoders are independent, so
+    // several can run at once on different threads.
+    class Decoder
+    {
+    public:
+        Decoder() : p(0), end(0) {}
+        bool next(trace_cycle &cycle); // false at the end of the block (or on bad data)
+
+    private:
+        friend class BinaryTraceReader;
+        const unsigned char *p;
+        const unsigned char *end;
+        trace_cycle state;
+        unsigned int ifCache[1024][2];
+        unsigned char ifCacheValid[1024];
+        bool get(unsigned long long &value);
+    };
+    void decodeBlock(unsigned int block, Decoder &decoder) const;
+
+    // read every cycle in order, one block after another
+    bool next(trace_cycle &cycle);
+
+private:
+    MappedFile file;
+    std::vector<const unsigned char *> blocks; // each block's header
+    unsigned int nextBlock;
+    Decoder sequential;
+};
+
+#endif // BINARYTRACE_H
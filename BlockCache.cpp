@@ -0,0 +1,103 @@
+/*************************************************************************
+ * BlockCache.cpp
+ *
+ * This file contains the class implementation for the basic block cache
+ * used by the functional model of the CPU.
+ *
+ * This code was developed as a demonstration for SER450 and is provided
+ * as-is as a learning aid for Chapter 4 of the class text.
+ *
+ * COPYRIGHT (C) 2019, Arizona State University
+ * ALL RIGHTS RESERVED
+ *
+ **************************************************************************/
+#include "BlockCache.h"
+#include "InstructionMemory.h"
+
+//********************************************
+// isIdleInstruction
+bool isIdleInstruction(const DecodedInstruction &decoded)
+{
+    if (decoded.control & (CTL_MEMWRITE | CTL_BRANCH | CTL_JUMP))
+        return false;
+    if (decoded.control & CTL_REGWRITE)
+    {
+        unsigned int regWrAddr = (decoded.control & CTL_REGDST) ? decoded.rd : decoded.rt;
+        return regWrAddr == 0;
+    }
+    return true;
+}
+
+//********************************************
+// lookup
+// find the block that starts at pc, or form a new one
+Block *BlockCache::lookup(unsigned int pc, const InstructionMemory &imem)
+{
+    std::unordered_map<unsigned int, std::unique_ptr<Block> >::iterator it = blocks.find(pc);
+    if (it != blocks.end())
+        return it->second.get();
+
+    std::unique_ptr<Block> block(new Block());
+    block->startPc = pc;
+    block->endsWithControl = false;
+    block->taken = 0;
+    block->fallthrough = 0;
+    block->selfLoop = false;
+    block->executions = 0;
+    block->native = 0;
+    block->nativeGeneration = 0;
+
+    // collect instructions up to and including the first branch or jump
+    // and its delay slot
+    unsigned int addr = pc;
+    while (block->ops.size() < BLOCK_MAX_INSTRUCTIONS)
+    {
+        const DecodedInstruction &decoded = imem.decoded(addr);
+        if (decoded.halt)
+            break;
+        block->ops.push_back(decoded);
+        addr += 4;
+        if (decoded.control & (CTL_BRANCH | CTL_JUMP))
+        {
+            // a control transfer or a break in the delay slot does not fit
+            // the block model
+            const DecodedInstruction &delay = imem.decoded(addr);
+            if ((delay.control & (CTL_BRANCH | CTL_JUMP)) || delay.halt)
+            {
+                blocks[pc].reset(); // remember that there is no block here
+                return 0;
+            }
+            block->ops.push_back(delay);
+            addr += 4;
+
+            // the target is relative to the address of the delay slot
+            if (decoded.control & CTL_BRANCH)
+                block->takenPc = (decoded.immed_se << 2) + (addr - 4);
+            else
+                block->takenPc = ((addr - 4) & 0xF0000000) | (decoded.jmpaddr << 2);
+            block->endsWithControl = true;
+            block->selfLoop = (decoded.control & CTL_JUMP) && (block->takenPc == pc) &&
+                              (block->ops.size() == 2) && isIdleInstruction(delay);
+            break;
+        }
+    }
+    if (block->ops.empty())
+    {
+        blocks[pc].reset(); // a break at pc
+        return 0;
+    }
+    block->fallthroughPc = addr;
+    if (!block->endsWithControl)
+        block->takenPc = addr;
+
+    Block *result = block.get();
+    blocks[pc] = std::move(block);
+    return result;
+}
+
+//********************************************
+// flush
+void BlockCache::flush()
+{
+    blocks.clear();
+}
@@ -0,0 +1,65 @@
+/*************************************************************************
+ * BlockCache.h
+ *
+ * This file contains the class definition for the basic block cache used
+ * by the functional model of the CPU.  A basic block is a straight-line
+ * run of predecoded instructions ending with a branch or jump and its
+ * delay slot.  Blocks are keyed by the address of their first instruction
+ * and hold direct pointers to their successor blocks once those are known.
+ *
+ * This code was developed as a demonstration for SER450 and is provided
+ * as-is as a learning aid for Chapter 4 of the class text.
+ *
+ * COPYRIGHT (C) 2019, Arizona State University
+ * ALL RIGHTS RESERVED
+ *
+ **************************************************************************/
+#ifndef BLOCKCACHE_H
+#define BLOCKCACHE_H
+#include <memory>
+#include <unordered_map>
+#include <vector>
+#include "Decoder.h"
+
+class InstructionMemory;
+
+// the most instructions placed in a single block
+#define BLOCK_MAX_INSTRUCTIONS 256
+
+// true if an instruction has no effect other than (possibly) writing
+// register 0, so that a jump to itself with this in the delay slot
+// is a halt loop
+bool isIdleInstruction(const DecodedInstruction &decoded);
+
+typedef struct block_t
+{
+    unsigned int startPc;
+    std::vector<DecodedInstruction> ops; // every instruction in the block, including the delay slot
+    bool endsWithControl;                // false if the block was cut off at BLOCK_MAX_INSTRUCTIONS
+    unsigned int takenPc;                // target of the branch or jump that ends the block
+    unsigned int fallthroughPc;          // the address following the block
+    struct block_t *taken;               // chained successors (0 until first followed)
+    struct block_t *fallthrough;
+    bool selfLoop;                       // the block is a jump to itself that does nothing else
+    unsigned int executions;             // times the block has been run
+    void *native;                        // translated code for the block, if any
+    unsigned int nativeGeneration;       // the Jit generation that native belongs to
+} Block;
+
+class BlockCache
+{
+public:
+    // return the block that starts at pc, forming it from instruction
+    // memory if it is not already cached.  Blocks end before a break
+    // instruction.  Returns 0 if no block can be formed (a branch or jump
+    // in a delay slot, or a break at pc).
+    Block *lookup(unsigned int pc, const InstructionMemory &imem);
+
+    // discard every block (instruction memory has changed)
+    void flush();
+
+private:
+    std::unordered_map<unsigned int, std::unique_ptr<Block> > blocks;
+};
+
+#endif // BLOCKCACHE_H
@@ -15,46 +15,252 @@
  *
  **************************************************************************/
 #include <stdio.h>
+#include <string.h>
 #include "Cpu.h"
+#include "Decoder.h"
+#include "MappedFile.h"
 
-// BITS(x, start, end) a macro function that takes three integer arguments
-//    the output of the function will be bits start-end of of value x but
-//    the bits in the output will be shifted so that bit start is at bit
-//    position 0.  Example: the input values 0x12345678, 8,12 will yield
-//    the result 0x00000006
-#define BITS(x, start, end) ((x >> start) & ((1 << (end - start + 1)) - 1))
+// COUNT_EVENT(counter) counts a forwarding, stall or instruction mix
+//    event, unless the trace level leaves the counters out.
+#define COUNT_EVENT(counter)                                       \
+    do                                                             \
+    {                                                              \
+        if constexpr (CpuConfig::traceLevel >= CPU_TRACE_COUNTERS) \
+            events.counter++;                                      \
+    } while (0)
 
-// SIGN_EXT(x) a macro to sign extend a 16 bit signed integer to 32 bits
-#define SIGN_EXT(x) ((x & 0x8000) ? (0xffff0000 | x) : x)
+// PRINT_FORWARDING(msg) prints a forwarding unit message, to the trace
+//    sink if there is one.
+#define PRINT_FORWARDING(msg)            \
+    do                                   \
+    {                                    \
+        if (traceSink)                   \
+            *traceSink << msg << '\n';   \
+        else                             \
+            printf("%s\n", msg);         \
+    } while (0)
+
+// LOG_FORWARDING(msg) prints the message when forwarding logging has been
+//    turned on with setForwardingLog(), or always, depending on the trace
+//    level (see CpuConfig.h).
+#define LOG_FORWARDING(msg)                                               \
+    do                                                                    \
+    {                                                                     \
+        if constexpr (CpuConfig::traceLevel == CPU_TRACE_ALWAYS)          \
+            PRINT_FORWARDING(msg);                                        \
+        else if constexpr (CpuConfig::traceLevel == CPU_TRACE_SWITCHABLE) \
+        {                                                                 \
+            if (forwardingLog)                                            \
+                PRINT_FORWARDING(msg);                                    \
+        }                                                                 \
+    } while (0)
+
+// the number of times a block is run by the functional model before it
+// is translated to native code
+#define JIT_HOT_THRESHOLD 16
+
+// Checkpoint layout.  All fields are in host byte order, and the state
+// record is the host's layout of checkpoint_state, so a checkpoint is only
+// loaded by a build of the simulator for the same kind of host.
+//
+//   checkpoint_header
+//   checkpoint_state
+//   pageCount records of a page number followed by the page's bytes
+//
+// The checksum is the FNV-1a hash of every byte that follows the header.
+#define CHECKPOINT_MAGIC 0x54504b43 // "CKPT" on a little-endian host
+#define CHECKPOINT_VERSION 4
+
+typedef struct
+{
+    unsigned int magic;
+    unsigned int version;
+    unsigned int stateSize; // sizeof(checkpoint_state) when it was written
+    unsigned int textChecksum; // of the program's instruction words
+    unsigned int pageCount;
+    unsigned int checksum;
+    unsigned int reserved[2];
+} checkpoint_header;
+
+static_assert(sizeof(checkpoint_header) == 32, "checkpoint header layout");
+
+static unsigned int fnv1a(const unsigned char *p, size_t length, unsigned int hash = 0x811c9dc5)
+{
+    for (size_t i = 0; i < length; i++)
+        hash = (hash ^ p[i]) * 0x01000193;
+    return hash;
+}
+
+// identifies the program in instruction memory, so that a checkpoint is
+// never restored into a Cpu running a different one
+static unsigned int textChecksum(const InstructionMemory &imem)
+{
+    unsigned int hash = 0x811c9dc5;
+    for (unsigned int i = 0; i < imem.size(); i++)
+    {
+        unsigned int word = imem.value(i << 2);
+        hash = fnv1a((const unsigned char *)&word, sizeof(word), hash);
+    }
+    return hash;
+}
 
-// each of the following are the opcodes for teh specified instruction from
-// the MIPS instruction set.
-#define OP_LW 0x23
-#define OP_SW 0x2B
-#define OP_RTYPE 0x00
-#define OP_BEQ 0x04
-#define OP_JMP 0x02
 
 //********************************************
 // Constructor
-Cpu::Cpu(DataMemory &dmem, RegisterFile &regs)
-    : dmem(dmem), regs(regs)
+Cpu::Cpu(const ProgramImage &image, DataMemory &dmem, RegisterFile &regs)
+    : image(image), imem(image.instructions()), dmem(dmem), regs(regs)
 {
+    image.loadData(dmem);
+    blockCacheVersion = imem.version();
+    textChecksumValid = false;
+    textChecksumVersion = 0;
+    textChecksumValue = 0;
+
     // initialize the register pipeline register outputs to 0
-    regIFID_IDside = {
-        0,
-    };
-    regIDEX_EXside = {0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0};
-    regEXMEM_MEMside = {0, 0, 0, 0, 0, 0, 0, 0};
-    regMEMWB_WBside = {0, 0, 0, 0};
+    latches[0] = {};
+    latches[1] = {};
+    phase = 0;
+    flushPipeline(0);
+    fetchEnabled = true;
+    functionalInstructions = 0;
+    clockCycle = 0;
+    haltStatus = HALT_NONE;
+    pendingHalt = HALT_NONE;
+    haltCycle = 0;
+    haltPredicate = 0;
+    haltContext = 0;
+    events = {};
+    hazardDetection = true;
+    stalled = false;
+    forwardingLog = false;
+    traceSink = 0;
+    binaryTrace = 0;
+    tracedEvents = {};
+    profiler = 0;
+    profiledEvents = {};
 }
+
 //********************************************
-// setImem
-// set the value of a 32-bit word at a specified
-// address in the CPU's instruction memory
-void Cpu::setImem(unsigned int address, unsigned int value)
+// Destructor
+Cpu::~Cpu()
+{
+}
+
+//********************************************
+// flushPipeline
+// set the outputs of all the pipeline registers
+// to bubbles so that the next instruction fetched
+// will be the one at the specified address
+void Cpu::flushPipeline(unsigned int pc)
+{
+    outputs().ifid = {};
+    outputs().idex = {};
+    outputs().exmem = {};
+    outputs().memwb = {};
+    outputs().idex.next_pc = pc;
+    pipelineEmpty = true;
+}
+
+//********************************************
+// setForwardingLog
+// turn printing of forwarding unit messages on or off
+void Cpu::setForwardingLog(bool enabled)
+{
+    forwardingLog = enabled;
+}
+
+//********************************************
+// setTraceSink
+// send forwarding unit messages to a trace sink
+// instead of the standard output
+void Cpu::setTraceSink(TraceSink *sink)
 {
-    imem.setAt(address, value);
+    traceSink = sink;
+}
+
+//********************************************
+// setBinaryTrace
+// record each clock cycle to a binary trace
+void Cpu::setBinaryTrace(BinaryTraceWriter *trace)
+{
+    binaryTrace = trace;
+    tracedEvents = events;
+}
+
+//********************************************
+// writeCounters
+// one JSON object per line, so that a file of them can
+// be read a line at a time
+void Cpu::writeCounters(std::ostream &out) const
+{
+    writeCounters(out, events, clockCycle);
+    out << "\n";
+}
+
+void Cpu::writeCounters(std::ostream &out, const event_counters &events, unsigned long long cycles)
+{
+    out << "{\"cycles\":" << cycles
+        << ",\"retired\":" << events.retired
+        << ",\"cpi\":" << (events.retired ? (double)cycles / (double)events.retired : 0.0)
+        << ",\"counted\":" << ((CpuConfig::traceLevel >= CPU_TRACE_COUNTERS) ? "true" : "false")
+        << ",\"nops\":" << events.nops
+        << ",\"branches_taken\":" << events.branchesTaken
+        << ",\"branches_not_taken\":" << events.branchesNotTaken
+        << ",\"jumps\":" << events.jumps
+        << ",\"loads\":" << events.loads
+        << ",\"stores\":" << events.stores
+        << ",\"load_use_stalls\":" << events.loadUseStalls
+        << ",\"branch_stalls\":" << events.branchStalls
+        << ",\"forwarding\":{\"mem_to_equality_rs\":" << events.memToEqualityRs
+        << ",\"mem_to_equality_rt\":" << events.memToEqualityRt
+        << ",\"mem_to_alu_a\":" << events.memToAluA
+        << ",\"mem_to_alu_b\":" << events.memToAluB
+        << ",\"wb_to_alu_a\":" << events.wbToAluA
+        << ",\"wb_to_alu_b\":" << events.wbToAluB
+        << "}}";
+}
+
+//********************************************
+// setProfiler
+// profile each clock cycle
+void Cpu::setProfiler(Profiler *profiler)
+{
+    this->profiler = profiler;
+    profiledEvents = events;
+}
+
+//********************************************
+// setHazardDetection
+// turn the hazard detection unit on or off
+void Cpu::setHazardDetection(bool enabled)
+{
+    hazardDetection = enabled;
+}
+
+//********************************************
+// getCpi
+// clock cycles per completed instruction
+double Cpu::getCpi() const
+{
+    if (events.retired == 0)
+        return 0.0;
+    return (double)clockCycle / (double)events.retired;
+}
+
+//********************************************
+// setJitEnabled
+// turn translation of hot blocks in the functional
+// model on or off
+void Cpu::setJitEnabled(bool enabled)
+{
+    if (!enabled)
+    {
+        jit.reset();
+        blockCache.flush(); // the blocks refer to the translated code
+        return;
+    }
+    if (!jit)
+        jit.reset(new Jit());
 }
 
 //********************************************
@@ -75,14 +281,25 @@ void Cpu::thread_if_start()
 {
     // set the signal values from the outputs of the
     // appropriate pipeline registers
-    unsigned int pc = regIDEX_EXside.next_pc;
+    unsigned int pc = outputs().idex.next_pc;
+
+    // while the pipeline is being drained, nothing new is fetched
+    if (!fetchEnabled)
+    {
+        inputs().ifid = {};
+        return;
+    }
 
     // fetch the current instruction
     unsigned int instruction = imem.value(pc);
 
     // assign our outputs to the inputs of the associated
-    // next-stage pipeline registers.
-    regIFID_IFside.instruction = instruction;
+    // next-stage pipeline registers.  The instruction was decoded
+    // when it was loaded so the decoded form is fetched along with it.
+    inputs().ifid.instruction = instruction;
+    inputs().ifid.pc = pc;
+    inputs().ifid.decoded = imem.decoded(pc);
+    inputs().ifid.valid = 1;
 }
 
 //*******************************************
@@ -94,59 +311,73 @@ void Cpu::thread_id_start()
 {
     // set the signal values from the outputs of the
     // appropriate pipeline registers
-    unsigned int instruction = regIFID_IDside.instruction;
-    unsigned int pc = regIDEX_EXside.next_pc;
-    unsigned int mem_regWrite = regEXMEM_MEMside.regWrite;       // for forwarding
-    unsigned int mem_registerNum = regEXMEM_MEMside.registerNum; // for forwarding
-    unsigned int mem_aluResult = regEXMEM_MEMside.aluResult;     // for forwarding
-
-    // extract the fields from the instruction
-    unsigned int opcode = BITS(instruction, 26, 31);
-    unsigned int funct = BITS(instruction, 0, 5);
-    unsigned int rdidx = BITS(instruction, 11, 15);
-    unsigned int rtidx = BITS(instruction, 16, 20);
-    unsigned int rsidx = BITS(instruction, 21, 25);
-    signed int immed = SIGN_EXT(BITS(instruction, 0, 15));
-    unsigned int jmpaddr = BITS(instruction, 0, 25);
-
-    // alu operation combinational logic
-    int ALUOp = 0x0;
-    if ((opcode == 0x23) || (opcode == 0x2b))
-        ALUOp = 0x0; // load or store instructions
-    if (opcode == 0x04)
-        ALUOp = 0x1; // branch on equal instruction
-    if (opcode == 0x00)
-        ALUOp = 0x2; // r-type instructions
-
-    // alu control combinational logic
-    int ALUControl = 0xF;
-    if (ALUOp == 0x0)
-        ALUControl = 0x2; // lw/sw -> add
-    if (ALUOp == 0x01)
-        ALUControl = 0x6; // lw/sw -> subtract
-    if (ALUOp == 0x02)
-    {
-        if (funct == 0x20)
-            ALUControl = 0x2; // add
-        if (funct == 0x22)
-            ALUControl = 0x6; // subtract
-        if (funct == 0x24)
-            ALUControl = 0x0; // AND
-        if (funct == 0x25)
-            ALUControl = 0x1; // OR
-        if (funct == 0x2a)
-            ALUControl = 0x7; // set-on-less-than
-    }
+    const DecodedInstruction &decoded = outputs().ifid.decoded;
+    unsigned int pc = outputs().idex.next_pc;
+    unsigned int mem_regWrite = outputs().exmem.regWrite;       // for forwarding
+    unsigned int mem_registerNum = outputs().exmem.registerNum; // for forwarding
+    unsigned int mem_aluResult = outputs().exmem.aluResult;     // for forwarding
+
+    // the instruction fields and the outputs of the alu operation and
+    // alu control logic were computed when the instruction was loaded
+    // into instruction memory (see decodeInstruction).
+    unsigned int rdidx = decoded.rd;
+    unsigned int rtidx = decoded.rt;
+    unsigned int rsidx = decoded.rs;
+    signed int immed = decoded.immed_se;
+    unsigned int jmpaddr = decoded.jmpaddr;
+    int ALUControl = decoded.aluOperation;
 
     // additional control signals based on opcode
-    unsigned int aluSrc = (opcode == OP_LW) || (opcode == OP_SW) ? 1 : 0;
-    unsigned int regDest = (opcode == OP_RTYPE) ? 1 : 0;
-    unsigned int branch = (opcode == OP_BEQ) ? 1 : 0;
-    unsigned int memRead = (opcode == OP_LW) ? 1 : 0;
-    unsigned int memToReg = (opcode == OP_LW) ? 1 : 0;
-    unsigned int memWrite = (opcode == OP_SW) ? 1 : 0;
-    unsigned int regWrite = (opcode == OP_LW) || (opcode == OP_RTYPE) ? 1 : 0;
-    unsigned int jump = (opcode == OP_JMP) ? 1 : 0;
+    unsigned int aluSrc = (decoded.control & CTL_ALUSRC) ? 1 : 0;
+    unsigned int regDest = (decoded.control & CTL_REGDST) ? 1 : 0;
+    unsigned int branch = (decoded.control & CTL_BRANCH) ? 1 : 0;
+    unsigned int memRead = (decoded.control & CTL_MEMREAD) ? 1 : 0;
+    unsigned int memToReg = (decoded.control & CTL_MEMTOREG) ? 1 : 0;
+    unsigned int memWrite = (decoded.control & CTL_MEMWRITE) ? 1 : 0;
+    unsigned int regWrite = (decoded.control & CTL_REGWRITE) ? 1 : 0;
+    unsigned int jump = (decoded.control & CTL_JUMP) ? 1 : 0;
+
+    //****************************************************
+    // Hazard detection unit.  Stall IF and ID for a cycle
+    // and send a bubble to EX when:
+    // - the instruction in EX is a load whose destination
+    //   is a source of the instruction in ID (load-use)
+    // - the instruction in ID is a beq and one of its
+    //   operands is produced by the instruction in EX, or
+    //   by a load in MEM (the equality unit only forwards
+    //   ALU results from MEM)
+    stalled = false;
+    if constexpr (CpuConfig::hazardUnit != CPU_HAZARD_UNIT_OFF)
+    {
+        // (a switchable unit may have been turned off)
+        if ((CpuConfig::hazardUnit == CPU_HAZARD_UNIT_ON) || hazardDetection)
+        {
+            unsigned int usesRt = regDest || memWrite || branch;
+            unsigned int ex_registerNum = outputs().idex.regDst ? outputs().idex.rd : outputs().idex.rt;
+            unsigned int ex_matches = (ex_registerNum != 0) &&
+                                      (((!jump) && (ex_registerNum == rsidx)) || (usesRt && (ex_registerNum == rtidx)));
+            unsigned int mem_matches = (mem_registerNum != 0) &&
+                                       ((mem_registerNum == rsidx) || (mem_registerNum == rtidx));
+            if (outputs().idex.memRead && ex_matches)
+            {
+                stalled = true;
+                COUNT_EVENT(loadUseStalls);
+            }
+            else if (branch && ((outputs().idex.regWrite && ex_matches) || (outputs().exmem.memRead && mem_matches)))
+            {
+                stalled = true;
+                COUNT_EVENT(branchStalls);
+            }
+        }
+    }
+    if (stalled)
+    {
+        // the bubble keeps the pc so that IF fetches the same instruction again
+        inputs().idex = {};
+        inputs().idex.next_pc = pc;
+        return;
+    }
+    //**** END HAZARD DETECTION UNIT ********
 
     // register file read operation based on rt and rd indicies
     unsigned int regRs = regs.readData1(rsidx);
@@ -168,16 +399,21 @@ void Cpu::thread_id_start()
     //   until the end of the clock cycle. This needs to be
     //   checked for by the compiler.
     unsigned equalityRs = regRs;
-    if ((mem_regWrite) && (mem_registerNum != 0) && (mem_registerNum == rsidx))
-    {
-        printf("Forwarding RS from MEM to Equality Unit\n");
-        equalityRs = mem_aluResult;
-    }
     unsigned equalityRt = regRt;
-    if ((mem_regWrite) && (mem_registerNum != 0) && (mem_registerNum == rtidx))
+    if constexpr (CpuConfig::equalityForwarding)
     {
-        printf("Forwarding RT from MEM to Equality Unit\n");
-        equalityRt = mem_aluResult;
+        if ((mem_regWrite) && (mem_registerNum != 0) && (mem_registerNum == rsidx))
+        {
+            COUNT_EVENT(memToEqualityRs);
+            LOG_FORWARDING("Forwarding RS from MEM to Equality Unit");
+            equalityRs = mem_aluResult;
+        }
+        if ((mem_regWrite) && (mem_registerNum != 0) && (mem_registerNum == rtidx))
+        {
+            COUNT_EVENT(memToEqualityRt);
+            LOG_FORWARDING("Forwarding RT from MEM to Equality Unit");
+            equalityRt = mem_aluResult;
+        }
     }
     unsigned int equal = (equalityRs == equalityRt) ? 1 : 0;
     //**** END EQUALITY UNIT ********
@@ -185,24 +421,45 @@ void Cpu::thread_id_start()
     // multiplexors to select the next program counter value
     next_pc = (branch && equal) ? branchAddr : pc + 4;
     next_pc = (jump) ? fullJumpAddr : next_pc;
+    if (branch && equal)
+        COUNT_EVENT(branchesTaken);
+    else if (branch)
+        COUNT_EVENT(branchesNotTaken);
+    if (jump)
+        COUNT_EVENT(jumps);
+
+    // halt detection - a break, or a jump to itself whose delay slot
+    // (fetched this cycle from the next address) does nothing.  The
+    // machine halts once the instructions in EX, MEM and WB complete.
+    if (pendingHalt == HALT_NONE)
+    {
+        if (decoded.halt)
+            pendingHalt = HALT_BREAK;
+        else if (jump && (fullJumpAddr == outputs().ifid.pc) && (pc == outputs().ifid.pc + 4) &&
+                 isIdleInstruction(inputs().ifid.decoded))
+            pendingHalt = HALT_SELF_LOOP;
+        haltCycle = clockCycle + 3;
+    }
 
     // assign our outputs to the inputs of the associated
     // next-stage pipeline registers.
-    regIDEX_IDside.aluOperation = ALUControl;
-    regIDEX_IDside.aluSrc = aluSrc;
-    regIDEX_IDside.immed_se = immed;
-    regIDEX_IDside.memRead = memRead;
-    regIDEX_IDside.memWrite = memWrite;
-    regIDEX_IDside.memToReg = memToReg;
-    regIDEX_IDside.next_pc = next_pc;
-    regIDEX_IDside.rd = rdidx;
-    regIDEX_IDside.rs = rsidx;
-    regIDEX_IDside.rt = rtidx;
-    regIDEX_IDside.regDst = regDest;
-    regIDEX_IDside.regRsDat = regRs;
-    regIDEX_IDside.regRtDat = regRt;
-    regIDEX_IDside.regWrite = regWrite;
-    regIDEX_IDside.instruction = regIFID_IDside.instruction;
+    inputs().idex.aluOperation = ALUControl;
+    inputs().idex.aluSrc = aluSrc;
+    inputs().idex.immed_se = immed;
+    inputs().idex.memRead = memRead;
+    inputs().idex.memWrite = memWrite;
+    inputs().idex.memToReg = memToReg;
+    inputs().idex.next_pc = next_pc;
+    inputs().idex.rd = rdidx;
+    inputs().idex.rs = rsidx;
+    inputs().idex.rt = rtidx;
+    inputs().idex.regDst = regDest;
+    inputs().idex.regRsDat = regRs;
+    inputs().idex.regRtDat = regRt;
+    inputs().idex.regWrite = regWrite;
+    inputs().idex.instruction = outputs().ifid.instruction;
+    inputs().idex.pc = outputs().ifid.pc;
+    inputs().idex.valid = outputs().ifid.valid;
 }
 
 //*******************************************
@@ -215,53 +472,61 @@ void Cpu::thread_ex_start()
 {
     // set the signal values from the outputs of the
     // appropriate pipeline registers
-    unsigned int ALUControl = regIDEX_EXside.aluOperation;
-    unsigned int regDest = regIDEX_EXside.regDst;
-    unsigned int regRs = regIDEX_EXside.regRsDat;
-    unsigned int regRt = regIDEX_EXside.regRtDat;
-    unsigned int immed = regIDEX_EXside.immed_se;
-    unsigned int aluSrc = regIDEX_EXside.aluSrc;
-    unsigned int rsidx = regIDEX_EXside.rs;
-    unsigned int rtidx = regIDEX_EXside.rt;
-    unsigned int rdidx = regIDEX_EXside.rd;
-    unsigned int wb_regWrite = regMEMWB_WBside.regWrite;
-    unsigned int wb_registerNum = regMEMWB_WBside.registerNum;
-    unsigned int wb_regWrData = regMEMWB_WBside.regWrData;
-    unsigned int mem_regWrite = regEXMEM_MEMside.regWrite;
-    unsigned int mem_registerNum = regEXMEM_MEMside.registerNum;
-    unsigned int mem_aluResult = regEXMEM_MEMside.aluResult;
+    unsigned int ALUControl = outputs().idex.aluOperation;
+    unsigned int regDest = outputs().idex.regDst;
+    unsigned int regRs = outputs().idex.regRsDat;
+    unsigned int regRt = outputs().idex.regRtDat;
+    unsigned int immed = outputs().idex.immed_se;
+    unsigned int aluSrc = outputs().idex.aluSrc;
+    unsigned int rsidx = outputs().idex.rs;
+    unsigned int rtidx = outputs().idex.rt;
+    unsigned int rdidx = outputs().idex.rd;
+    unsigned int wb_regWrite = outputs().memwb.regWrite;
+    unsigned int wb_registerNum = outputs().memwb.registerNum;
+    unsigned int wb_regWrData = outputs().memwb.regWrData;
+    unsigned int mem_regWrite = outputs().exmem.regWrite;
+    unsigned int mem_registerNum = outputs().exmem.registerNum;
+    unsigned int mem_aluResult = outputs().exmem.aluResult;
 
     // Forwarding Unit Logic
     unsigned int forwardA = 0;
     unsigned int forwardB = 0;
 
-    // Check for forwarding from the MEM stage
-    if (mem_regWrite && mem_registerNum != 0)
+    // (the unit may be built out, see CpuConfig.h)
+    if constexpr (CpuConfig::forwarding)
     {
-        if (mem_registerNum == rsidx)
+        // Check for forwarding from the MEM stage
+        if (mem_regWrite && mem_registerNum != 0)
         {
-            forwardA = 2;
-            printf("Forwarding RS from MEM to ALU input\n");
+            if (mem_registerNum == rsidx)
+            {
+                forwardA = 2;
+                COUNT_EVENT(memToAluA);
+                LOG_FORWARDING("Forwarding RS from MEM to ALU input");
+            }
+            if (mem_registerNum == rtidx)
+            {
+                forwardB = 2;
+                COUNT_EVENT(memToAluB);
+                LOG_FORWARDING("Forwarding RT from MEM to ALU input");
+            }
         }
-        if (mem_registerNum == rtidx)
-        {
-            forwardB = 2;
-            printf("Forwarding RT from MEM to ALU input\n");
-        }
-    }
 
-    // Check for forwarding from the WB stage
-    if (wb_regWrite && wb_registerNum != 0)
-    {
-        if (wb_registerNum == rsidx && forwardA == 0)
-        {
-            forwardA = 1;
-            printf("Forwarding RS from WB to ALU input\n");
-        }
-        if (wb_registerNum == rtidx && forwardB == 0)
+        // Check for forwarding from the WB stage
+        if (wb_regWrite && wb_registerNum != 0)
         {
-            forwardB = 1;
-            printf("Forwarding RT from WB to ALU input\n");
+            if (wb_registerNum == rsidx && forwardA == 0)
+            {
+                forwardA = 1;
+                COUNT_EVENT(wbToAluA);
+                LOG_FORWARDING("Forwarding RS from WB to ALU input");
+            }
+            if (wb_registerNum == rtidx && forwardB == 0)
+            {
+                forwardB = 1;
+                COUNT_EVENT(wbToAluB);
+                LOG_FORWARDING("Forwarding RT from WB to ALU input");
+            }
         }
     }
 
@@ -280,7 +545,33 @@ void Cpu::thread_ex_start()
     unsigned int operand2 = aluSrc ? immed : dat2;
 
     // ALU combinational logic
-    int ALUResult = 0;
+    int ALUResult = alu(ALUControl, operand1, operand2);
+    int zero = (ALUResult == 0x00000000) ? 1 : 0;
+
+    // register write destination multiplexor
+    unsigned int regWrAddr = regDest ? rdidx : rtidx;
+
+    // assign our outputs to the inputs of the associated
+    // next-stage pipeline registers.
+    inputs().exmem.aluResult = ALUResult;
+    inputs().exmem.dat2 = dat2;
+    inputs().exmem.registerNum = regWrAddr;
+    inputs().exmem.memRead = outputs().idex.memRead;
+    inputs().exmem.memToReg = outputs().idex.memToReg;
+    inputs().exmem.memWrite = outputs().idex.memWrite;
+    inputs().exmem.regWrite = outputs().idex.regWrite;
+    inputs().exmem.instruction = outputs().idex.instruction;
+    inputs().exmem.pc = outputs().idex.pc;
+    inputs().exmem.valid = outputs().idex.valid;
+}
+
+//*******************************************
+// alu
+// The ALU combinational logic.  Unknown ALU
+// operations produce 0.
+unsigned int Cpu::alu(unsigned int ALUControl, unsigned int operand1, unsigned int operand2)
+{
+    unsigned int ALUResult = 0;
     if (ALUControl == 0x0)
         ALUResult = operand1 & operand2; // and
     if (ALUControl == 0x1)
@@ -293,21 +584,7 @@ void Cpu::thread_ex_start()
         ALUResult = (operand1 < operand2) ? 1 : 0; // set less than
     if (ALUControl == 0xc)
         ALUResult = ~(operand1 | operand2); // nor
-    int zero = (ALUResult == 0x00000000) ? 1 : 0;
-
-    // register write destination multiplexor
-    unsigned int regWrAddr = regDest ? rdidx : rtidx;
-
-    // assign our outputs to the inputs of the associated
-    // next-stage pipeline registers.
-    regEXMEM_EXside.aluResult = ALUResult;
-    regEXMEM_EXside.dat2 = dat2;
-    regEXMEM_EXside.registerNum = regWrAddr;
-    regEXMEM_EXside.memRead = regIDEX_EXside.memRead;
-    regEXMEM_EXside.memToReg = regIDEX_EXside.memToReg;
-    regEXMEM_EXside.memWrite = regIDEX_EXside.memWrite;
-    regEXMEM_EXside.regWrite = regIDEX_EXside.regWrite;
-    regEXMEM_EXside.instruction = regIDEX_EXside.instruction;
+    return ALUResult;
 }
 
 //*******************************************
@@ -319,24 +596,30 @@ void Cpu::thread_mem_start()
 {
     // set the signal values from the outputs of the
     // appropriate pipeline registers
-    unsigned int ALUResult = regEXMEM_MEMside.aluResult;
-    unsigned int memRead = regEXMEM_MEMside.memRead;
-    unsigned int memToReg = regEXMEM_MEMside.memToReg;
-    unsigned int memWrite = regEXMEM_MEMside.memWrite;
-    unsigned int dat2 = regEXMEM_MEMside.dat2;
+    unsigned int ALUResult = outputs().exmem.aluResult;
+    unsigned int memRead = outputs().exmem.memRead;
+    unsigned int memToReg = outputs().exmem.memToReg;
+    unsigned int memWrite = outputs().exmem.memWrite;
+    unsigned int dat2 = outputs().exmem.dat2;
 
     // read the data memory if required
     unsigned int memData = dmem.read(ALUResult, memRead);
+    if (memRead)
+        COUNT_EVENT(loads);
+    if (memWrite)
+        COUNT_EVENT(stores);
 
     // register write data multipelexor
     unsigned int regWrData = memToReg ? memData : ALUResult;
 
     // assign our outputs to the inputs of the associated
     // next-stage pipeline registers.
-    regMEMWB_MEMside.registerNum = regEXMEM_MEMside.registerNum;
-    regMEMWB_MEMside.regWrite = regEXMEM_MEMside.regWrite;
-    regMEMWB_MEMside.regWrData = regWrData;
-    regMEMWB_MEMside.instruction = regEXMEM_MEMside.instruction;
+    inputs().memwb.registerNum = outputs().exmem.registerNum;
+    inputs().memwb.regWrite = outputs().exmem.regWrite;
+    inputs().memwb.regWrData = regWrData;
+    inputs().memwb.instruction = outputs().exmem.instruction;
+    inputs().memwb.pc = outputs().exmem.pc;
+    inputs().memwb.valid = outputs().exmem.valid;
 
     // update memory at the end of this clock cycle
     dmem.update(ALUResult, dat2, memWrite);
@@ -351,13 +634,20 @@ void Cpu::thread_wb_start()
 {
     // set the signal values from the outputs of the
     // appropriate pipeline registers
-    unsigned int regWrAddr = regMEMWB_WBside.registerNum;
-    unsigned int regWrite = regMEMWB_WBside.regWrite;
-    unsigned int regWrData = regMEMWB_WBside.regWrData;
+    unsigned int regWrAddr = outputs().memwb.registerNum;
+    unsigned int regWrite = outputs().memwb.regWrite;
+    unsigned int regWrData = outputs().memwb.regWrData;
 
     // update the register contents at the first halof of
     // the clock cycle
     regs.update(regWrAddr, regWrData, regWrite);
+
+    if (outputs().memwb.valid)
+    {
+        events.retired++;
+        if (outputs().memwb.instruction == 0)
+            COUNT_EVENT(nops);
+    }
 }
 
 //*************************************************
@@ -376,39 +666,482 @@ void Cpu::update()
     thread_ex_start();
     thread_mem_start();
 
-    // update the pipeline registers on the rising edge of the clock
-    // in real hardware, these updates would all happen simultaneously
-    regIFID_IDside = regIFID_IFside;
-    regIDEX_EXside = regIDEX_IDside;
-    regEXMEM_MEMside = regEXMEM_EXside;
-    regMEMWB_WBside = regMEMWB_MEMside;
+    // the output sides still show what was in each stage this cycle
+    if constexpr (CpuConfig::traceLevel >= CPU_TRACE_SWITCHABLE)
+    {
+        if (profiler)
+            profileCycle();
+    }
+
+    // update the pipeline registers on the rising edge of the clock.
+    // The input sides become the output sides, as they would all at
+    // once in real hardware (a stall holds the instruction in ID)
+    if (stalled)
+        inputs().ifid = outputs().ifid;
+    phase ^= 1;
+
+    pipelineEmpty = false;
+    clockCycle++;
 
-    clockCycle++;   
+    if ((pendingHalt != HALT_NONE) && (clockCycle >= haltCycle) && (haltStatus == HALT_NONE))
+        haltStatus = pendingHalt;
+
+    if constexpr (CpuConfig::traceLevel >= CPU_TRACE_SWITCHABLE)
+    {
+        if (binaryTrace)
+            recordTrace();
+    }
+}
+
+//*************************************************
+// run()
+// simulate clock cycles until the machine halts or
+// the cycle limit is reached
+Cpu::run_result Cpu::run(unsigned long long maxCycles)
+{
+    run_result result = {haltStatus, 0};
+    while ((result.status == HALT_NONE) && (result.cycles < maxCycles))
+    {
+        update();
+        result.cycles++;
+        if ((haltStatus == HALT_NONE) && haltPredicate && haltPredicate(*this, haltContext))
+            haltStatus = HALT_PREDICATE;
+        result.status = haltStatus;
+    }
+    return result;
+}
+
+//*************************************************
+// setHaltPredicate()
+// install a function that is called after every clock
+// cycle of run() and halts the machine when it returns
+// true.  Pass 0 to remove it.
+void Cpu::setHaltPredicate(halt_predicate predicate, void *context)
+{
+    haltPredicate = predicate;
+    haltContext = context;
+}
+
+//*************************************************
+// drainPipeline()
+// Run clock cycles without fetching until every
+// instruction in flight has completed.  On return, pc
+// holds the address of the first instruction that was
+// not fetched and npc the address that follows it
+// (these differ from pc+4 when the last instruction
+// decoded was a taken branch or a jump).
+void Cpu::drainPipeline(unsigned int &pc, unsigned int &npc)
+{
+    pc = outputs().idex.next_pc;
+    fetchEnabled = false;
+
+    // the ID stage resolves the next pc for the instruction it holds
+    // (once any stall for it is over)
+    do
+    {
+        update();
+    } while (stalled);
+    npc = outputs().idex.next_pc;
+
+    // let the instructions in EX, MEM and WB complete
+    update();
+    update();
+    update();
+    fetchEnabled = true;
+}
+
+//*************************************************
+// executeInstruction()
+// The execute, memory and write back work of a single
+// non-control-flow instruction in the functional model.
+inline void Cpu::executeInstruction(const DecodedInstruction &decoded, unsigned int regRs, unsigned int regRt)
+{
+    unsigned int operand2 = (decoded.control & CTL_ALUSRC) ? decoded.immed_se : regRt;
+    unsigned int ALUResult = alu(decoded.aluOperation, regRs, operand2);
+    if (decoded.control & CTL_MEMWRITE)
+        dmem.update(ALUResult, regRt, true);
+    if (decoded.control & CTL_REGWRITE)
+    {
+        unsigned int regWrData = (decoded.control & CTL_MEMTOREG) ? dmem.read(ALUResult, true) : ALUResult;
+        unsigned int regWrAddr = (decoded.control & CTL_REGDST) ? decoded.rd : decoded.rt;
+        regs.update(regWrAddr, regWrData, true);
+    }
+}
+
+//*************************************************
+// executeBlock()
+// Run every instruction of a basic block without
+// fetching from instruction memory.  pc is set to the
+// address of the next instruction and the chain
+// pointer to the successor block is returned (it
+// holds 0 if the successor is not yet known).
+Block **Cpu::executeBlock(Block *block, unsigned int &pc)
+{
+    const DecodedInstruction *ops = &block->ops[0];
+    unsigned int count = block->ops.size();
+    if (!block->endsWithControl)
+    {
+        for (unsigned int i = 0; i < count; i++)
+            executeInstruction(ops[i], regs.readData1(ops[i].rs), regs.readData2(ops[i].rt));
+        pc = block->fallthroughPc;
+        return &block->fallthrough;
+    }
+
+    for (unsigned int i = 0; i < count - 2; i++)
+        executeInstruction(ops[i], regs.readData1(ops[i].rs), regs.readData2(ops[i].rt));
+
+    // resolve the branch before its delay slot runs
+    const DecodedInstruction &control = ops[count - 2];
+    bool taken = (control.control & CTL_JUMP) ||
+                 (regs.readData1(control.rs) == regs.readData2(control.rt));
+    const DecodedInstruction &delay = ops[count - 1];
+    executeInstruction(delay, regs.readData1(delay.rs), regs.readData2(delay.rt));
+
+    if (taken)
+    {
+        pc = block->takenPc;
+        return &block->taken;
+    }
+    pc = block->fallthroughPc;
+    return &block->fallthrough;
+}
+
+//*************************************************
+// runFunctional()
+// Execute instructions against the register file and
+// data memory.  Whole basic blocks are run from the
+// block cache, following chained successor pointers,
+// whenever the instruction budget and stop pc allow;
+// otherwise instructions are run one at a time.  The
+// architectural program counter is modeled as a pc/npc
+// pair so that branch and jump delay slots behave
+// exactly as they do in the pipeline.
+unsigned long long Cpu::runFunctional(unsigned long long maxInstructions, unsigned int stopPc)
+{
+    unsigned int pc = outputs().idex.next_pc;
+    unsigned int npc = pc + 4;
+    if (!pipelineEmpty)
+        drainPipeline(pc, npc);
+
+    // any cached blocks or translated code are stale if the
+    // program has been changed since they were formed
+    if (blockCacheVersion != imem.version())
+    {
+        blockCache.flush();
+        if (jit)
+            jit->flush();
+        blockCacheVersion = imem.version();
+    }
+
+    unsigned long long count = 0;
+    Block *block = 0; // the block at pc, when it is known from chaining
+    while ((count < maxInstructions) || (npc != pc + 4))
+    {
+        // only stop on an instruction that is not in a delay slot
+        if ((pc == stopPc) && (npc == pc + 4))
+            break;
+
+        if (npc == pc + 4)
+        {
+            if (!block)
+                block = blockCache.lookup(pc, imem);
+
+            // the whole block must fit in the budget and must not contain the stop pc
+            unsigned int size = block ? block->ops.size() : 0;
+            if (block && (count < maxInstructions) && (size <= maxInstructions - count) &&
+                ((stopPc - pc) / 4 >= size))
+            {
+                if (block->selfLoop)
+                {
+                    haltStatus = HALT_SELF_LOOP;
+                    break;
+                }
+
+                // translate the block once it has been run often enough,
+                // and again if its code was discarded when the Jit's
+                // buffer filled up
+                block->executions++;
+                if (jit && block->native && (block->nativeGeneration != jit->getGeneration()))
+                    block->native = 0;
+                if (jit && (!block->native) && (block->executions >= JIT_HOT_THRESHOLD))
+                {
+                    block->native = jit->translate(*block);
+                    block->nativeGeneration = jit->getGeneration();
+                }
+
+                if (block->native)
+                {
+                    unsigned long long budget = maxInstructions - count;
+                    unsigned long long before = budget;
+                    pc = jit->execute(block->native, regs.data(), &dmem, budget, stopPc);
+                    npc = pc + 4;
+                    count += before - budget;
+                    block = 0;
+                    continue;
+                }
+
+                // run the block and follow (or create) the chain to its successor
+                Block **chain = executeBlock(block, pc);
+                Block *next = *chain;
+                if (!next)
+                    next = *chain = blockCache.lookup(pc, imem);
+                npc = pc + 4;
+                count += size;
+                block = next;
+                continue;
+            }
+        }
+        block = 0;
+
+        // run a single instruction
+        const DecodedInstruction &decoded = imem.decoded(pc);
+        if (decoded.halt)
+        {
+            haltStatus = HALT_BREAK;
+            break;
+        }
+        if ((npc == pc + 4) && (decoded.control & CTL_JUMP) &&
+            (((npc & 0xF0000000) | (decoded.jmpaddr << 2)) == pc) && isIdleInstruction(imem.decoded(npc)))
+        {
+            haltStatus = HALT_SELF_LOOP;
+            break;
+        }
+        unsigned int regRs = regs.readData1(decoded.rs);
+        unsigned int regRt = regs.readData2(decoded.rt);
+
+        // next pc logic - the target is relative to the address of the delay slot
+        unsigned int target = npc + 4;
+        if ((decoded.control & CTL_BRANCH) && (regRs == regRt))
+            target = (decoded.immed_se << 2) + npc;
+        if (decoded.control & CTL_JUMP)
+            target = (npc & 0xF0000000) | (decoded.jmpaddr << 2);
+
+        executeInstruction(decoded, regRs, regRt);
+
+        pc = npc;
+        npc = target;
+        count++;
+    }
+
+    // hand off to the pipeline model
+    flushPipeline(pc);
+    functionalInstructions += count;
+    return count;
+}
+
+//*************************************************
+// programChecksum()
+unsigned int Cpu::programChecksum() const
+{
+    if (!textChecksumValid || (textChecksumVersion != imem.version()))
+    {
+        textChecksumValue = textChecksum(imem);
+        textChecksumVersion = imem.version();
+        textChecksumValid = true;
+    }
+    return textChecksumValue;
+}
+
+//*************************************************
+// saveCheckpoint()
+// write the machine state into a checkpoint buffer.
+// Only the data memory pages that have been written
+// are stored.
+void Cpu::saveCheckpoint(std::vector<unsigned char> &checkpoint) const
+{
+    checkpoint_state state;
+    memset(&state, 0, sizeof(state));
+    state.latches[0] = inputs();
+    state.latches[1] = outputs();
+    state.events = events;
+    state.clockCycle = clockCycle;
+    state.functionalInstructions = functionalInstructions;
+    state.haltCycle = haltCycle;
+    state.haltStatus = haltStatus;
+    state.pendingHalt = pendingHalt;
+    memcpy(state.regs, regs.data(), sizeof(state.regs));
+    state.fetchEnabled = fetchEnabled;
+    state.hazardDetection = hazardDetection;
+    state.stalled = stalled;
+    state.pipelineEmpty = pipelineEmpty;
+    state.bigEndian = dmem.isBigEndian();
+
+    std::vector<unsigned int> pageNumbers;
+    dmem.modifiedPages(pageNumbers);
+
+    // lay out the checkpoint in the buffer
+    size_t pageRecord = sizeof(unsigned int) + DMEM_PAGE_SIZE;
+    checkpoint.resize(sizeof(checkpoint_header) + sizeof(state) + pageNumbers.size() * pageRecord);
+    unsigned char *p = checkpoint.data() + sizeof(checkpoint_header);
+    memcpy(p, &state, sizeof(state));
+    p += sizeof(state);
+    for (unsigned int i = 0; i < pageNumbers.size(); i++)
+    {
+        memcpy(p, &pageNumbers[i], sizeof(unsigned int));
+        memcpy(p + sizeof(unsigned int), dmem.pageData(pageNumbers[i]), DMEM_PAGE_SIZE);
+        p += pageRecord;
+    }
+
+    checkpoint_header header = {CHECKPOINT_MAGIC, CHECKPOINT_VERSION, (unsigned int)sizeof(state),
+                                programChecksum(), (unsigned int)pageNumbers.size(), 0, {0, 0}};
+    header.checksum = fnv1a(checkpoint.data() + sizeof(header), checkpoint.size() - sizeof(header));
+    memcpy(checkpoint.data(), &header, sizeof(header));
+}
+
+bool Cpu::saveCheckpoint(const char *filename) const
+{
+    std::vector<unsigned char> checkpoint;
+    saveCheckpoint(checkpoint);
+    FILE *out = fopen(filename, "wb");
+    if (!out)
+        return false;
+    bool written = fwrite(checkpoint.data(), 1, checkpoint.size(), out) == checkpoint.size();
+    return (fclose(out) == 0) && written;
+}
+
+//*************************************************
+// loadCheckpoint()
+// The whole checkpoint is checked before any state
+// is changed.
+bool Cpu::loadCheckpoint(const unsigned char *checkpoint, size_t size)
+{
+    checkpoint_header header;
+    if (size < sizeof(header))
+        return false;
+    memcpy(&header, checkpoint, sizeof(header));
+    size_t pageRecord = sizeof(unsigned int) + DMEM_PAGE_SIZE;
+    if ((header.magic != CHECKPOINT_MAGIC) || (header.version != CHECKPOINT_VERSION) ||
+        (header.stateSize != sizeof(checkpoint_state)) ||
+        (size != sizeof(header) + sizeof(checkpoint_state) + header.pageCount * pageRecord) ||
+        (fnv1a(checkpoint + sizeof(header), size - sizeof(header)) != header.checksum) ||
+        (header.textChecksum != programChecksum()))
+        return false;
+
+    checkpoint_state state;
+    memcpy(&state, checkpoint + sizeof(header), sizeof(state));
+    inputs() = state.latches[0];
+    outputs() = state.latches[1];
+    events = state.events;
+    tracedEvents = events;
+    profiledEvents = events;
+    clockCycle = state.clockCycle;
+    functionalInstructions = state.functionalInstructions;
+    haltCycle = state.haltCycle;
+    haltStatus = (halt_status)state.haltStatus;
+    pendingHalt = (halt_status)state.pendingHalt;
+    memcpy(regs.data(), state.regs, sizeof(state.regs));
+    fetchEnabled = state.fetchEnabled != 0;
+    hazardDetection = state.hazardDetection != 0;
+    stalled = state.stalled != 0;
+    pipelineEmpty = state.pipelineEmpty != 0;
+
+    dmem.clear();
+    dmem.setBigEndian(state.bigEndian != 0);
+    const unsigned char *p = checkpoint + sizeof(header) + sizeof(state);
+    for (unsigned int i = 0; i < header.pageCount; i++)
+    {
+        unsigned int pageNumber;
+        memcpy(&pageNumber, p, sizeof(pageNumber));
+        dmem.setPageData(pageNumber, p + sizeof(pageNumber));
+        p += pageRecord;
+    }
+    return true;
+}
+
+bool Cpu::loadCheckpoint(const char *filename)
+{
+    MappedFile file;
+    if (!file.open(filename))
+        return false;
+    return loadCheckpoint(file.data(), file.size());
 }
 
 //**********************************************************************
 // dump()
 // dump the state of the CPU object to the standard output device
-// Updated dump() function
+// or a trace sink
 void Cpu::dump()
 {
-    printf("Clock Cycle: %d\n", clockCycle);
+    TraceSink sink(stdout, false, 4096);
+    dump(sink);
+}
 
-    // Print forwarding messages
-    if (forwardingMessage[0] != '\0')
-    {
-        printf("%s\n", forwardingMessage);
-        forwardingMessage[0] = '\0'; // Clear the message
-    }
+void Cpu::dump(TraceSink &sink)
+{
+    trace_cycle cycle;
+    traceState(cycle);
+    dumpTraceCycle(cycle, sink);
+}
+
+//********************************************
+// traceState
+// collect the state that dump() prints
+void Cpu::traceState(trace_cycle &cycle) const
+{
+    cycle.cycle = clockCycle;
+    cycle.pc = outputs().idex.next_pc;
+    cycle.stages[TRACE_STAGE_IF] = imem.value(cycle.pc);
+    cycle.stages[TRACE_STAGE_ID] = outputs().ifid.instruction;
+    cycle.stages[TRACE_STAGE_EXE] = outputs().idex.instruction;
+    cycle.stages[TRACE_STAGE_MEM] = outputs().exmem.instruction;
+    cycle.stages[TRACE_STAGE_WB] = outputs().memwb.instruction;
+    cycle.events = 0;
+    cycle.changedRegs = 0;
+    memcpy(cycle.regs, regs.data(), sizeof(cycle.regs));
+}
+
+//********************************************
+// eventsSince
+// the events whose counters have moved since a
+// snapshot of them was taken, and take a new one
+unsigned int Cpu::eventsSince(event_counters &snapshot) const
+{
+    const unsigned long long before[TRACE_EVENT_COUNT] = {
+        snapshot.memToEqualityRs, snapshot.memToEqualityRt, snapshot.memToAluA, snapshot.memToAluB,
+        snapshot.wbToAluA, snapshot.wbToAluB, snapshot.loadUseStalls, snapshot.branchStalls};
+    const unsigned long long after[TRACE_EVENT_COUNT] = {
+        events.memToEqualityRs, events.memToEqualityRt, events.memToAluA, events.memToAluB,
+        events.wbToAluA, events.wbToAluB, events.loadUseStalls, events.branchStalls};
+    unsigned int moved = 0;
+    for (unsigned int i = 0; i < TRACE_EVENT_COUNT; i++)
+        if (after[i] != before[i])
+            moved |= 1u << i;
+    snapshot = events;
+    return moved;
+}
 
-    printf("PIPELINE\n");
-    printf("IF:  %08x (PC = %08x)\n", imem.value(regIDEX_EXside.next_pc), regIDEX_EXside.next_pc);
-    printf("ID:  %08x\n", regIFID_IDside.instruction);
-    printf("EXE: %08x\n", regIDEX_EXside.instruction);
-    printf("MEM: %08x\n", regEXMEM_MEMside.instruction);
-    printf("WB:  %08x\n", regMEMWB_WBside.instruction);
-
-    printf("REGISTER FILE\n");
-    regs.dump();
-    printf("\n");
-}
\ No newline at end of file
+//********************************************
+// recordTrace
+// add the cycle just completed to the binary trace
+void Cpu::recordTrace()
+{
+    trace_cycle cycle;
+    traceState(cycle);
+    cycle.events = eventsSince(tracedEvents);
+    binaryTrace->record(cycle);
+}
+
+//********************************************
+// profileCycle
+// tell the profiler which instruction is in each
+// stage during this cycle
+void Cpu::profileCycle()
+{
+    const pipeline_latches &stages = outputs();
+    Profiler::cycle_sample sample;
+    sample.pc[TRACE_STAGE_IF] = stages.idex.next_pc;
+    sample.instruction[TRACE_STAGE_IF] = imem.value(stages.idex.next_pc);
+    sample.pc[TRACE_STAGE_ID] = stages.ifid.pc;
+    sample.instruction[TRACE_STAGE_ID] = stages.ifid.instruction;
+    sample.pc[TRACE_STAGE_EXE] = stages.idex.pc;
+    sample.instruction[TRACE_STAGE_EXE] = stages.idex.instruction;
+    sample.pc[TRACE_STAGE_MEM] = stages.exmem.pc;
+    sample.instruction[TRACE_STAGE_MEM] = stages.exmem.instruction;
+    sample.pc[TRACE_STAGE_WB] = stages.memwb.pc;
+    sample.instruction[TRACE_STAGE_WB] = stages.memwb.instruction;
+    sample.valid = (fetchEnabled ? (1u << TRACE_STAGE_IF) : 0) | (stages.ifid.valid ? (1u << TRACE_STAGE_ID) : 0) |
+                   (stages.idex.valid << TRACE_STAGE_EXE) | (stages.exmem.valid << TRACE_STAGE_MEM) |
+                   (stages.memwb.valid << TRACE_STAGE_WB);
+    sample.events = eventsSince(profiledEvents);
+    profiler->record(sample);
+}
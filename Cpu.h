@@ -21,78 +21,155 @@
 #include "DataMemory.h"
 #include "InstructionMemory.h"
 #include "RegisterFile.h"
-#include <string>
+#include "ProgramImage.h"
+#include "BlockCache.h"
+#include "CpuConfig.h"
+#include "Jit.h"
+#include "TraceSink.h"
+#include "BinaryTrace.h"
+#include "Profiler.h"
+#include <memory>
+#include <ostream>
+#include <stddef.h>
 
 class Cpu
 {
+public:
+    // the performance counters: counts of the events seen by the
+    // forwarding logic, one for each forwarding path, and by the hazard
+    // detection unit, and of the kinds of instruction executed
+    typedef struct
+    {
+        unsigned long long memToEqualityRs; // RS from MEM to the equality unit
+        unsigned long long memToEqualityRt; // RT from MEM to the equality unit
+        unsigned long long memToAluA;       // RS from MEM to ALU input A
+        unsigned long long memToAluB;       // RT from MEM to ALU input B
+        unsigned long long wbToAluA;        // RS from WB to ALU input A
+        unsigned long long wbToAluB;        // RT from WB to ALU input B
+        unsigned long long loadUseStalls;   // stall cycles waiting for a load result
+        unsigned long long branchStalls;    // stall cycles waiting for a beq operand
+        unsigned long long retired;         // instructions completed by WB
+        unsigned long long nops;            // of which were nops
+        unsigned long long branchesTaken;   // beqs resolved in ID
+        unsigned long long branchesNotTaken;
+        unsigned long long jumps;
+        unsigned long long loads;           // memory reads in MEM
+        unsigned long long stores;          // memory writes in MEM
+    } event_counters;
+
+    // the reasons the machine can halt
+    typedef enum
+    {
+        HALT_NONE,      // still running
+        HALT_SELF_LOOP, // reached a jump to itself with the pipeline drained
+        HALT_BREAK,     // reached a break instruction
+        HALT_PREDICATE  // the halt predicate returned true
+    } halt_status;
+
+    // the result of a call to run()
+    typedef struct
+    {
+        halt_status status;        // HALT_NONE if the cycle limit was reached
+        unsigned long long cycles; // clock cycles simulated by this call
+    } run_result;
+
+    // a user supplied halt condition, checked after every clock cycle
+    typedef bool (*halt_predicate)(Cpu &cpu, void *context);
+
 private:
-    // typedefs for the pipeline registers
+    // typedefs for the pipeline registers.  The single bit control
+    // signals and the register numbers are packed into one word.
     typedef struct
     {
         // control and data signals from the IF stage
         unsigned int instruction;
+        unsigned int pc;            // the address of the instruction
+        DecodedInstruction decoded; // predecoded fields and control signals
+        unsigned int valid;         // 0 for a bubble
     } ifid_reg;
 
     typedef struct
     {
         // control and data from the ID stage
-        unsigned char regWrite;
-        unsigned char memToReg;
-        unsigned char memRead;
-        unsigned char memWrite;
-        unsigned char regDst;
-        unsigned char aluOperation;
-        unsigned char aluSrc;
+        unsigned int regWrite : 1;
+        unsigned int memToReg : 1;
+        unsigned int memRead : 1;
+        unsigned int memWrite : 1;
+        unsigned int regDst : 1;
+        unsigned int aluSrc : 1;
+        unsigned int valid : 1; // 0 for a bubble
+        unsigned int aluOperation : 4;
+        unsigned int rs : 5;
+        unsigned int rt : 5;
+        unsigned int rd : 5;
         unsigned int regRsDat;
         unsigned int regRtDat;
-        unsigned int rs;
-        unsigned int rt;
-        unsigned int rd;
         unsigned int immed_se;
         unsigned int next_pc;     // this pipeline field is used to hold
                                   // the value of the PC register
         unsigned int instruction; // this is only used for dump support
+        unsigned int pc;          // and the address of the instruction for profiling
     } idex_reg;
 
     typedef struct
     {
         // control and data from the EX stage
-        unsigned char regWrite;
-        unsigned char memToReg;
-        unsigned char memRead;
-        unsigned char memWrite;
+        unsigned int regWrite : 1;
+        unsigned int memToReg : 1;
+        unsigned int memRead : 1;
+        unsigned int memWrite : 1;
+        unsigned int valid : 1;       // 0 for a bubble
+        unsigned int registerNum : 5; // the register index to write back to
+                                      // in the writeback stage
         unsigned int aluResult;
-        unsigned int dat2;         // the value of the second operand
-                                   // (used in store operations)
-        unsigned char registerNum; // the register index to write back to
-                                   // in the writeback stage
-        unsigned int instruction;  // this is only used for dump support
+        unsigned int dat2;        // the value of the second operand
+                                  // (used in store operations)
+        unsigned int instruction; // this is only used for dump support
+        unsigned int pc;          // and the address of the instruction for profiling
     } exmem_reg;
 
     typedef struct
     {
-        unsigned char regWrite;
-        unsigned int regWrData;    // the data to be written back
-        unsigned char registerNum; // the regter index to write back to
-        unsigned int instruction;  // this is only used for dump support
+        unsigned int regWrite : 1;
+        unsigned int valid : 1;       // 0 for a bubble
+        unsigned int registerNum : 5; // the regter index to write back to
+        unsigned int regWrData;       // the data to be written back
+        unsigned int instruction;     // this is only used for dump support
+        unsigned int pc;              // and the address of the instruction for profiling
     } memwb_reg;
 
+    // one side of every pipeline register
+    typedef struct
+    {
+        ifid_reg ifid;
+        idex_reg idex;
+        exmem_reg exmem;
+        memwb_reg memwb;
+    } pipeline_latches;
+
     // data members for the class
-    InstructionMemory imem;
-    DataMemory dmem;
-    RegisterFile regs;
+    // the program image is shared with other Cpus and is never changed
+    // by the Cpu.  The data memory and register file belong to the caller.
+    const ProgramImage &image;
+    const InstructionMemory &imem;
+    DataMemory &dmem;
+    RegisterFile &regs;
 
     // pipeline registers - each one is represented by an input side
-    // and an output side.  At the end of each clock cycle, the output
-    // side values will be set to the input side values.
+    // and an output side.  The two sides of all four registers are held
+    // in latches, and phase selects which is the output side.  At the end
+    // of each clock cycle phase flips, so the input side values become
+    // the output side values without being copied.
     // combinational logic will use the output side of the registers
     //    as input to the combinational logic.
     //
-    //     regY_xside  -->  x_combinational_logic  --> regZ_xside
-    ifid_reg regIFID_IFside, regIFID_IDside;
-    idex_reg regIDEX_IDside, regIDEX_EXside;
-    exmem_reg regEXMEM_EXside, regEXMEM_MEMside;
-    memwb_reg regMEMWB_MEMside, regMEMWB_WBside;
+    //     outputs().y  -->  x_combinational_logic  --> inputs().z
+    pipeline_latches latches[2];
+    unsigned int phase;
+    pipeline_latches &inputs() { return latches[phase ^ 1]; }
+    pipeline_latches &outputs() { return latches[phase]; }
+    const pipeline_latches &inputs() const { return latches[phase ^ 1]; }
+    const pipeline_latches &outputs() const { return latches[phase]; }
 
     // "thread functions" for each of the
     // pipelined combinational logic.
@@ -102,22 +179,167 @@ private:
     void thread_mem_start();
     void thread_wb_start();
 
-    int clockCycle;
-    std::string forwardingMessage;
+    // the ALU combinational logic, shared by the EX stage and the
+    // functional model
+    static unsigned int alu(unsigned int ALUControl, unsigned int operand1, unsigned int operand2);
+
+    // functional model support
+    void flushPipeline(unsigned int pc); // fill the pipeline registers with bubbles
+    void drainPipeline(unsigned int &pc, unsigned int &npc);
+    bool fetchEnabled;  // when false, the IF stage inserts bubbles
+    bool hazardDetection; // when true, the hazard detection unit is active
+    bool stalled;       // the hazard detection unit stalled IF and ID this cycle
+    bool pipelineEmpty; // true when no instructions are in flight
+    unsigned long long functionalInstructions;
+
+    // basic block cache and dynamic binary translation support
+    // for the functional model
+    BlockCache blockCache;
+    unsigned int blockCacheVersion; // the instruction memory version the blocks were formed from
+    std::unique_ptr<Jit> jit;
+    void executeInstruction(const DecodedInstruction &decoded, unsigned int regRs, unsigned int regRt);
+    Block **executeBlock(Block *block, unsigned int &pc);
+
+    // halt detection
+    halt_status haltStatus;     // set once the machine has halted
+    halt_status pendingHalt;    // a halt seen in ID, waiting for the pipeline to drain
+    unsigned long long haltCycle;
+    halt_predicate haltPredicate;
+    void *haltContext;
+
+    unsigned long long clockCycle;
+    event_counters events;
+    bool forwardingLog; // print a message for each forwarding event
+    TraceSink *traceSink; // where the messages go, 0 for the standard output
+    BinaryTraceWriter *binaryTrace; // where each cycle is recorded, or 0
+    event_counters tracedEvents;    // the counters when the last cycle was recorded
+    void traceState(trace_cycle &cycle) const; // the state that dump() shows
+    void recordTrace();
+    Profiler *profiler;              // where each cycle is profiled, or 0
+    event_counters profiledEvents;   // the counters when the last cycle was profiled
+    void profileCycle();
+    unsigned int eventsSince(event_counters &snapshot) const; // TRACE_EVENT_xxx bits, and update the snapshot
+
+    // the machine state held in a checkpoint, apart from data memory
+    typedef struct
+    {
+        pipeline_latches latches[2]; // input sides, output sides
+        event_counters events;
+        unsigned long long clockCycle;
+        unsigned long long functionalInstructions;
+        unsigned long long haltCycle;
+        unsigned int haltStatus;
+        unsigned int pendingHalt;
+        unsigned int regs[32];
+        unsigned char fetchEnabled;
+        unsigned char hazardDetection;
+        unsigned char stalled;
+        unsigned char pipelineEmpty;
+        unsigned char bigEndian; // the data memory byte order
+    } checkpoint_state;
+
+    // the checksum of the program's instruction words, which ties a
+    // checkpoint to its program; it is only computed again once the
+    // instruction memory version changes
+    mutable bool textChecksumValid;
+    mutable unsigned int textChecksumVersion;
+    mutable unsigned int textChecksumValue;
+    unsigned int programChecksum() const;
 
 public:
-    Cpu();
-    Cpu(DataMemory &dmem, RegisterFile &regs);
+    // The Cpu runs the program in image, using dmem and regs for its
+    // state.  The image's initial data is copied into dmem.  The image,
+    // dmem and regs must outlive the Cpu.  Any number of Cpus may share
+    // one image.
+    Cpu(const ProgramImage &image, DataMemory &dmem, RegisterFile &regs);
+    ~Cpu();
     void update(); // run the simulation
+
+    // Run clock cycles until the machine halts or maxCycles cycles have
+    // been simulated.  The machine halts when it reaches a jump to itself
+    // whose delay slot does nothing (once the instructions ahead of it
+    // have completed), when a break instruction reaches ID (likewise), or
+    // when the halt predicate returns true.
+    run_result run(unsigned long long maxCycles);
+    void setHaltPredicate(halt_predicate predicate, void *context);
+    bool isHalted() const { return haltStatus != HALT_NONE; }
+    halt_status getHaltStatus() const { return haltStatus; }
+    unsigned long long getClockCycle() const { return clockCycle; }
     void setDmem(unsigned int addr, unsigned int data);
     // place a value in data memory
-    void setImem(unsigned int addr, unsigned int data); // place a value in instruction memory
     void dump();                                        // dump the cpu state to the standard output device
+    void dump(TraceSink &sink);                         // or to a trace sink
+
+    // forwarding and hazard event counters, and optional printing of
+    // each forwarding event.  Which of these are built in is chosen when
+    // the simulator is compiled (see CpuConfig.h); counters that are
+    // built out stay at zero.
+    const event_counters &getEvents() const { return events; }
+
+    // write the counters as one line of JSON, with the cycles and CPI.  The
+    // static form writes the JSON object alone (without the end of line),
+    // for other reports to hold the same schema.
+    void writeCounters(std::ostream &out) const;
+    static void writeCounters(std::ostream &out, const event_counters &events, unsigned long long cycles);
+    void setForwardingLog(bool enabled);
+    void setTraceSink(TraceSink *sink); // 0 for the standard output
+
+    // record every clock cycle from now on to a binary trace (see
+    // BinaryTrace.h), or stop recording with 0.  Nothing is recorded in
+    // builds with a trace level below CPU_TRACE_SWITCHABLE (see CpuConfig.h).
+    void setBinaryTrace(BinaryTraceWriter *trace);
+
+    // charge every clock cycle from now on to the instructions in the
+    // pipeline (see Profiler.h), or stop profiling with 0.  As with the
+    // trace, nothing is profiled below CPU_TRACE_SWITCHABLE.
+    void setProfiler(Profiler *profiler);
+
+    // the average clock cycles per instruction completed so far
+    double getCpi() const;
+
+    // The hazard detection unit stalls IF and ID and inserts a bubble into
+    // EX when the instruction in ID needs the result of a load that is in
+    // EX, or when a beq in ID needs a result that is not yet available to
+    // the equality unit.  It is on by default; turn it off to run code
+    // that schedules its own delays with nops.  Builds that fix the unit
+    // on or off at compile time ignore this (see CpuConfig.h).
+    void setHazardDetection(bool enabled);
+
+    // Functional (instruction-at-a-time) execution.  Instructions are executed
+    // directly against the register file and data memory without simulating
+    // the pipeline, starting from the instruction the pipeline would fetch next.
+    // Execution stops after maxInstructions instructions or when the next
+    // instruction is at stopPc.  A branch and its delay slot are never split,
+    // so up to one extra instruction may be executed.  On return the pipeline
+    // registers hold bubbles and update() continues from the next instruction.
+    // Execution also stops at a break instruction or a jump to itself, which
+    // halt the machine.  Returns the number of instructions executed.
+    static const unsigned int NO_STOP_PC = 0xffffffff;
+    unsigned long long runFunctional(unsigned long long maxInstructions, unsigned int stopPc = NO_STOP_PC);
+    unsigned long long getFunctionalInstructions() const { return functionalInstructions; }
+
+    // Checkpoints.  A checkpoint holds the pipeline registers, the clock
+    // cycle, the counters, the register file and the data memory pages that
+    // differ from the memory's starting state, so a run can be restarted
+    // from the middle.  Restoring needs a Cpu built from the same program;
+    // it replaces all of data memory, returning pages of copy-on-write
+    // mapped files that the checkpoint doesn't hold to the files' contents.
+    // Pages of write-back files that the checkpoint doesn't hold keep their
+    // current contents.  The load functions return false, changing nothing,
+    // if the checkpoint is not valid or was taken from a different program.
+    void saveCheckpoint(std::vector<unsigned char> &checkpoint) const;
+    bool saveCheckpoint(const char *filename) const;
+    bool loadCheckpoint(const unsigned char *checkpoint, size_t size);
+    bool loadCheckpoint(const char *filename);
+
+    // When enabled, basic blocks that the functional model executes often
+    // are translated into native code (on hosts that support it).
+    void setJitEnabled(bool enabled);
 
     // New method to get the program counter (PC)
     unsigned int getPC() const
     {
-        return regIDEX_IDside.next_pc; // Assuming next_pc is the program counter in the ID/EX register
+        return outputs().idex.next_pc; // next_pc holds the program counter in the ID/EX register
     }
 };
 
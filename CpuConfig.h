@@ -0,0 +1,89 @@
+/*************************************************************************
+ * CpuConfig.h
+ *
+ * This file contains the compile-time configuration of the CPU.  Each
+ * feature of the pipeline model can be built in, built out, or (where it
+ * makes sense) left switchable at run time.  Features that are built out
+ * cost nothing: the code for them is discarded when Cpu.cpp is compiled,
+ * so update() carries no tests for them.
+ *
+ * The configuration is chosen with preprocessor definitions when the
+ * simulator is built, either feature by feature or with a preset:
+ *
+ *   CPU_CONFIG_FAST   forwarding and hazard detection always on, no
+ *                     counters apart from retired instructions, no logging
+ *   CPU_CONFIG_DEBUG  everything counted and every forwarding event logged
+ *
+ * Without either, every feature is built in, with hazard detection and
+ * forwarding logging switchable at run time.  This is not quite how the
+ * simulator first behaved: the hazard detection unit, which it lacked, is
+ * active unless turned off, and forwarding events are no longer logged
+ * unless logging is turned on (the -f option of the drivers).
+ *
+ * This code was developed as a demonstration for SER450 and is provided
+ * as-is as a learning aid for Chapter 4 of the class text.
+ *
+ * COPYRIGHT (C) 2019, Arizona State University
+ * ALL RIGHTS RESERVED
+ *
+ **************************************************************************/
+#ifndef CPUCONFIG_H
+#define CPUCONFIG_H
+
+// settings for CPU_HAZARD_UNIT
+#define CPU_HAZARD_UNIT_OFF 0        // built out, setHazardDetection has no effect
+#define CPU_HAZARD_UNIT_ON 1         // always active, setHazardDetection has no effect
+#define CPU_HAZARD_UNIT_SWITCHABLE 2 // active unless turned off with setHazardDetection
+
+// settings for CPU_TRACE_LEVEL
+#define CPU_TRACE_NONE 0       // only retired instructions are counted
+#define CPU_TRACE_COUNTERS 1   // forwarding, stall and instruction mix events are counted too
+#define CPU_TRACE_SWITCHABLE 2 // and forwarding events are logged once setForwardingLog turns it on, and
+                               // cycles are recorded once setBinaryTrace or setProfiler is called
+#define CPU_TRACE_ALWAYS 3     // and every forwarding event is logged
+
+#if defined(CPU_CONFIG_FAST)
+#define CPU_HAZARD_UNIT CPU_HAZARD_UNIT_ON
+#define CPU_TRACE_LEVEL CPU_TRACE_NONE
+#elif defined(CPU_CONFIG_DEBUG)
+#define CPU_TRACE_LEVEL CPU_TRACE_ALWAYS
+#endif
+
+// the forwarding unit in EX, from MEM and WB to the ALU inputs
+#ifndef CPU_FORWARDING
+#define CPU_FORWARDING 1
+#endif
+
+// forwarding from MEM to the equality unit in ID
+#ifndef CPU_EQUALITY_FORWARDING
+#define CPU_EQUALITY_FORWARDING 1
+#endif
+
+#ifndef CPU_HAZARD_UNIT
+#define CPU_HAZARD_UNIT CPU_HAZARD_UNIT_SWITCHABLE
+#endif
+
+// CPU_FORWARDING_LOG is the older way of asking for every forwarding
+// event to be logged
+#ifndef CPU_TRACE_LEVEL
+#ifdef CPU_FORWARDING_LOG
+#define CPU_TRACE_LEVEL CPU_TRACE_ALWAYS
+#else
+#define CPU_TRACE_LEVEL CPU_TRACE_SWITCHABLE
+#endif
+#endif
+
+struct CpuConfig
+{
+    static constexpr bool forwarding = CPU_FORWARDING != 0;
+    static constexpr bool equalityForwarding = CPU_EQUALITY_FORWARDING != 0;
+    static constexpr int hazardUnit = CPU_HAZARD_UNIT;
+    static constexpr int traceLevel = CPU_TRACE_LEVEL;
+};
+
+// the hazard detection unit only covers the hazards that forwarding
+// leaves, so it can't be used without forwarding
+static_assert((CpuConfig::forwarding && CpuConfig::equalityForwarding) || (CpuConfig::hazardUnit == CPU_HAZARD_UNIT_OFF),
+              "the hazard detection unit needs forwarding");
+
+#endif // CPUCONFIG_H
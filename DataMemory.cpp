@@ -14,29 +14,289 @@
 * Author: Doug Sandy
 *
 **************************************************************************/
+#include <string.h>
 #include "DataMemory.h"
 
+#if defined(__BYTE_ORDER__) && (__BYTE_ORDER__ == __ORDER_BIG_ENDIAN__)
+#define DMEM_HOST_BIG_ENDIAN true
+#else
+#define DMEM_HOST_BIG_ENDIAN false
+#endif
+
+static inline unsigned int swapBytes(unsigned int value)
+{
+#if defined(__GNUC__)
+    return __builtin_bswap32(value);
+#else
+    return (value >> 24) | ((value >> 8) & 0xff00) | ((value << 8) & 0xff0000) | (value << 24);
+#endif
+}
+
+DataMemory::DataMemory()
+{
+    pages = 0;
+    bigEndian = false;
+    swapWords = DMEM_HOST_BIG_ENDIAN;
+    lastPageNumber = 0;
+    lastPage = 0;
+    lastPageModified = false;
+}
+
+DataMemory::DataMemory(const DataMemory &other)
+{
+    pages = 0;
+    bigEndian = false;
+    swapWords = DMEM_HOST_BIG_ENDIAN;
+    lastPageNumber = 0;
+    lastPage = 0;
+    lastPageModified = false;
+    *this = other;
+}
+
+DataMemory &DataMemory::operator=(const DataMemory &other)
+// copy the pages of another memory, allocating only the pages it has written
+// or mapped
+{
+    if (this == &other) return *this;
+
+    // drop any mapped files first so that nothing below writes to them
+    for (unsigned int i = 0; (i < DMEM_DIRECTORY_SIZE) && !files.empty(); i++) {
+        if (!directory[i]) continue;
+        for (unsigned int j = 0; j < DMEM_TABLE_SIZE; j++)
+            if (directory[i]->mapped[j >> 5] & (1u << (j & 31))) setPage((i << DMEM_TABLE_BITS) | j, 0, false);
+    }
+    files.clear();
+
+    for (unsigned int i = 0; i < DMEM_DIRECTORY_SIZE; i++) {
+        const page_table *source = other.directory[i].get();
+        if ((!source) && (!directory[i])) continue;
+        for (unsigned int j = 0; j < DMEM_TABLE_SIZE; j++) {
+            const unsigned char *bytes = source ? source->entries[j] : 0;
+            if (!bytes) setPage((i << DMEM_TABLE_BITS) | j, 0, false);
+            else memcpy(allocatePage((i << DMEM_TABLE_BITS) | j), bytes, DMEM_PAGE_SIZE);
+        }
+        if (!source) directory[i].reset();
+    }
+    bigEndian = other.bigEndian;
+    swapWords = other.swapWords;
+    lastPageNumber = 0;
+    lastPage = 0;
+    lastPageModified = false;
+    return *this;
+}
+
+DataMemory::~DataMemory()
+{
+    for (unsigned int i = 0; i < DMEM_DIRECTORY_SIZE; i++) {
+        if (!directory[i]) continue;
+        for (unsigned int j = 0; j < DMEM_TABLE_SIZE; j++) setPage((i << DMEM_TABLE_BITS) | j, 0, false);
+    }
+}
+
+DataMemory::page_table *DataMemory::findTable(unsigned int pageNumber)
+// return the page table that holds a page, creating it if needed
+{
+    std::unique_ptr<page_table> &table = directory[pageNumber >> DMEM_TABLE_BITS];
+    if (!table) {
+        table.reset(new page_table);
+        memset(table.get(), 0, sizeof(page_table));
+    }
+    return table.get();
+}
+
+void DataMemory::setPage(unsigned int pageNumber, unsigned char *bytes, bool mapped)
+// replace a page table entry, freeing the page it held if that page was allocated here
+{
+    page_table *table = directory[pageNumber >> DMEM_TABLE_BITS].get();
+    if ((!table) && (!bytes)) return;
+    if (!table) table = findTable(pageNumber);
+    unsigned int entry = pageNumber & (DMEM_TABLE_SIZE - 1);
+    unsigned int bit = 1u << (entry & 31);
+    if (table->entries[entry] && !(table->mapped[entry >> 5] & bit)) {
+        delete[] table->entries[entry];
+        pages--;
+    }
+    table->entries[entry] = bytes;
+    if (mapped) table->mapped[entry >> 5] |= bit;
+    else table->mapped[entry >> 5] &= ~bit;
+    table->written[entry >> 5] &= ~bit;
+    if ((lastPage) && (lastPageNumber == pageNumber)) lastPage = 0;
+}
+
+unsigned char *DataMemory::findPage(unsigned int pageNumber)
+// return the page with the specified number, or 0 if it has never been written
+{
+    if ((lastPage) && (pageNumber == lastPageNumber)) return lastPage;
+    page_table *table = directory[pageNumber >> DMEM_TABLE_BITS].get();
+    if (!table) return 0;
+    unsigned int entry = pageNumber & (DMEM_TABLE_SIZE - 1);
+    unsigned char *found = table->entries[entry];
+    if (!found) return 0;
+    lastPageNumber = pageNumber;
+    lastPage = found;
+    lastPageModified = !(table->mapped[entry >> 5] & (1u << (entry & 31))) || (table->written[entry >> 5] & (1u << (entry & 31)));
+    return lastPage;
+}
+
+unsigned char *DataMemory::allocatePage(unsigned int pageNumber)
+// return the page with the specified number, creating a zero page if needed
+{
+    unsigned char *bytes = findPage(pageNumber);
+    if (bytes) {
+        // the first write to a mapped page marks it as modified
+        if (!lastPageModified) {
+            unsigned int entry = pageNumber & (DMEM_TABLE_SIZE - 1);
+            directory[pageNumber >> DMEM_TABLE_BITS]->written[entry >> 5] |= 1u << (entry & 31);
+            lastPageModified = true;
+        }
+        return bytes;
+    }
+    bytes = new unsigned char[DMEM_PAGE_SIZE];
+    memset(bytes, 0, DMEM_PAGE_SIZE);
+    setPage(pageNumber, bytes, false);
+    pages++;
+    lastPageNumber = pageNumber;
+    lastPage = bytes;
+    lastPageModified = true;
+    return lastPage;
+}
+
+bool DataMemory::mapFile(unsigned int address, const char *filename, bool writeBack)
+// the pages of the file replace whatever the memory held in that range
+{
+    if (address & (DMEM_PAGE_SIZE - 1)) return false;
+    std::unique_ptr<MappedFile> file(new MappedFile);
+    if (!file->open(filename, writeBack ? MappedFile::MAP_WRITE_BACK : MappedFile::MAP_COPY)) return false;
+    unsigned long long pageTotal = (file->size() + DMEM_PAGE_SIZE - 1) / DMEM_PAGE_SIZE;
+    if ((address >> DMEM_PAGE_BITS) + pageTotal > (unsigned long long)DMEM_DIRECTORY_SIZE * DMEM_TABLE_SIZE) return false;
+
+    for (unsigned int i = 0; i < pageTotal; i++)
+        setPage((address >> DMEM_PAGE_BITS) + i, file->data() + (unsigned long long)i * DMEM_PAGE_SIZE, true);
+    files.push_back(std::move(file));
+    return true;
+}
+
+bool DataMemory::mapFilePages(const char *filename, unsigned int firstFilePage, const unsigned int *pageNumbers,
+                              unsigned int count)
+// the pages need not be contiguous in memory, so a file can hold the pages of a sparse data segment
+{
+    std::unique_ptr<MappedFile> file(new MappedFile);
+    if (!file->open(filename, MappedFile::MAP_COPY)) return false;
+    unsigned long long filePages = (file->size() + DMEM_PAGE_SIZE - 1) / DMEM_PAGE_SIZE;
+    if ((unsigned long long)firstFilePage + count > filePages) return false;
+
+    for (unsigned int i = 0; i < count; i++)
+        setPage(pageNumbers[i] & (DMEM_DIRECTORY_SIZE * DMEM_TABLE_SIZE - 1),
+                file->data() + (unsigned long long)(firstFilePage + i) * DMEM_PAGE_SIZE, true);
+    files.push_back(std::move(file));
+    return true;
+}
+
+void DataMemory::modifiedPages(std::vector<unsigned int> &pageNumbers) const
+{
+    pageNumbers.clear();
+    for (unsigned int i = 0; i < DMEM_DIRECTORY_SIZE; i++) {
+        const page_table *table = directory[i].get();
+        if (!table) continue;
+        for (unsigned int j = 0; j < DMEM_TABLE_SIZE; j++) {
+            unsigned int bit = 1u << (j & 31);
+            if ((table->entries[j]) && (!(table->mapped[j >> 5] & bit) || (table->written[j >> 5] & bit)))
+                pageNumbers.push_back((i << DMEM_TABLE_BITS) | j);
+        }
+    }
+}
+
+const unsigned char *DataMemory::pageData(unsigned int pageNumber) const
+{
+    const page_table *table = directory[(pageNumber >> DMEM_TABLE_BITS) & (DMEM_DIRECTORY_SIZE - 1)].get();
+    return table ? table->entries[pageNumber & (DMEM_TABLE_SIZE - 1)] : 0;
+}
+
+void DataMemory::setPageData(unsigned int pageNumber, const unsigned char *bytes)
+{
+    memcpy(allocatePage(pageNumber & (DMEM_DIRECTORY_SIZE * DMEM_TABLE_SIZE - 1)), bytes, DMEM_PAGE_SIZE);
+}
+
+void DataMemory::clear()
+{
+    for (unsigned int i = 0; i < DMEM_DIRECTORY_SIZE; i++) {
+        page_table *table = directory[i].get();
+        if (!table) continue;
+        for (unsigned int j = 0; j < DMEM_TABLE_SIZE; j++) {
+            unsigned int bit = 1u << (j & 31);
+            if (!(table->mapped[j >> 5] & bit)) setPage((i << DMEM_TABLE_BITS) | j, 0, false);
+            else if (table->written[j >> 5] & bit) revertPage(table, j);
+        }
+    }
+    lastPage = 0;
+}
+
+void DataMemory::revertPage(page_table *table, unsigned int entry)
+// read a written page of a mapped file back from the file, if the mapping is a copy
+{
+    unsigned char *bytes = table->entries[entry];
+    for (unsigned int i = 0; i < files.size(); i++) {
+        MappedFile &file = *files[i];
+        if ((bytes < file.data()) || (bytes >= file.data() + file.size())) continue;
+        if (file.revert(bytes - file.data(), DMEM_PAGE_SIZE)) table->written[entry >> 5] &= ~(1u << (entry & 31));
+        return;
+    }
+}
+
+unsigned char DataMemory::readByte(unsigned int address)
+{
+    unsigned char *bytes = findPage(address >> DMEM_PAGE_BITS);
+    return bytes ? bytes[address & (DMEM_PAGE_SIZE - 1)] : 0;
+}
+
+void DataMemory::writeByte(unsigned int address, unsigned char value)
+{
+    allocatePage(address >> DMEM_PAGE_BITS)[address & (DMEM_PAGE_SIZE - 1)] = value;
+}
+
+void DataMemory::setBigEndian(bool big)
+{
+    bigEndian = big;
+    swapWords = (big != DMEM_HOST_BIG_ENDIAN);
+}
+
 void DataMemory::update(unsigned int address, unsigned int data, bool write)
 // called for each system clock tick to update the state of the component
 // if write is true, store the data in memory.  otherwise, do nothing
 {
-    if (address > 2048) return;
-    if (write) {
-        memory[address] = data & 0xff;
-        memory[address+1] = (data>>8)&0xff;
-        memory[address+2] = (data>>16)&0xff;
-        memory[address+3] = (data>>24)&0xff;
+    if (!write) return;
+
+    // an aligned word lies within a single page and is stored with one
+    // host word store
+    if ((address & 3) == 0) {
+        if (swapWords) data = swapBytes(data);
+        memcpy(allocatePage(address >> DMEM_PAGE_BITS) + (address & (DMEM_PAGE_SIZE - 1)), &data, 4);
+        return;
+    }
+
+    // anything else is stored a byte at a time, and may cross a page
+    // boundary (or wrap around the top of memory)
+    for (unsigned int i = 0; i < 4; i++) {
+        unsigned int shift = bigEndian ? 24 - 8 * i : 8 * i;
+        writeByte(address + i, (data >> shift) & 0xff);
     }
 }
 
 unsigned int DataMemory::read(unsigned int address, bool read)
+// returns the value of the currently addressed word
 {
-    // check to make sure the address is within our memory space
-    if (address>2048) return 0;
+    if ((address & 3) == 0) {
+        unsigned char *bytes = findPage(address >> DMEM_PAGE_BITS);
+        if (!bytes) return 0;
+        unsigned int value;
+        memcpy(&value, bytes + (address & (DMEM_PAGE_SIZE - 1)), 4);
+        return swapWords ? swapBytes(value) : value;
+    }
 
-    // returns the value of the currently addressed word
-    return (((unsigned int)memory[address+3])<<24) +
-            (((unsigned int)memory[address+2])<<16) +
-            (((unsigned int)memory[address+1])<<8) +
-            ((unsigned int)memory[address+0]);
+    unsigned int value = 0;
+    for (unsigned int i = 0; i < 4; i++) {
+        unsigned int shift = bigEndian ? 24 - 8 * i : 8 * i;
+        value |= ((unsigned int)readByte(address + i)) << shift;
+    }
+    return value;
 }
@@ -16,17 +16,94 @@
 **************************************************************************/
 #ifndef DATAMEMORY_H
 #define DATAMEMORY_H
+#include <memory>
+#include <vector>
+#include "MappedFile.h"
 
+// the data memory covers the full 32-bit address space as 4 KB pages
+// reached through a two-level page table: bits 31-22 of an address select
+// a page table, bits 21-12 a page in that table and bits 11-0 the byte
+#define DMEM_PAGE_BITS 12
+#define DMEM_PAGE_SIZE (1u << DMEM_PAGE_BITS)
+#define DMEM_TABLE_BITS 10
+#define DMEM_TABLE_SIZE (1u << DMEM_TABLE_BITS)
+#define DMEM_DIRECTORY_SIZE (1u << (32 - DMEM_PAGE_BITS - DMEM_TABLE_BITS))
 
 class DataMemory
 {
     public:
+        DataMemory();
+        DataMemory(const DataMemory &other);
+        DataMemory &operator=(const DataMemory &other);
+        ~DataMemory();
+
         void update(unsigned int address, unsigned int data, bool write);
         unsigned int read(unsigned int addr, bool read);
+
+        // the number of pages that have been written
+        unsigned int pageCount() const { return pages; }
+
+        // select the byte order of words in memory.  Memory is little-endian
+        // unless set otherwise, and the order should be chosen before
+        // anything is written.
+        void setBigEndian(bool big);
+        bool isBigEndian() const { return bigEndian; }
+
+        // Map a host file into memory starting at a page aligned address.
+        // With writeBack false, writes to the mapped range change only this
+        // memory; with writeBack true they are saved to the file.  Pages of
+        // the file are only read from disk as they are touched.  Copying
+        // the memory copies the mapped pages, the copy is not file backed.
+        // Returns false if the file can't be mapped at that address.
+        bool mapFile(unsigned int address, const char *filename, bool writeBack = false);
+
+        // Map pages of a host file copy-on-write: the file's 4 KB page
+        // firstFilePage + i becomes page pageNumbers[i] of memory, replacing
+        // what the memory held there.  Writes change only this memory.
+        // Returns false if the file can't be mapped or is too short.
+        bool mapFilePages(const char *filename, unsigned int firstFilePage, const unsigned int *pageNumbers,
+                          unsigned int count);
+
+        // Page level access for checkpoints.  The modified pages are the
+        // ones that differ from the memory's starting state: every allocated
+        // page and every mapped page that has been written.  clear() returns
+        // the memory to its starting state: it frees the allocated pages and
+        // reads written pages of copy-on-write mappings back from their
+        // files.  Written pages of write-back files keep their contents.
+        void modifiedPages(std::vector<unsigned int> &pageNumbers) const;
+        const unsigned char *pageData(unsigned int pageNumber) const; // 0 for a page never written
+        void setPageData(unsigned int pageNumber, const unsigned char *bytes);
+        void clear();
     protected:
 
     private:
-        unsigned char memory[2048];
+        typedef struct
+        {
+            unsigned char *entries[DMEM_TABLE_SIZE];
+            unsigned int mapped[DMEM_TABLE_SIZE / 32];  // a bit for each entry that is in a mapped file
+            unsigned int written[DMEM_TABLE_SIZE / 32]; // a bit for each mapped entry that has been written
+        } page_table;
+
+        // pages are only allocated when first written; a page that has
+        // never been written reads as zero
+        std::unique_ptr<page_table> directory[DMEM_DIRECTORY_SIZE];
+        unsigned int pages; // allocated pages, not counting mapped ones
+        std::vector<std::unique_ptr<MappedFile> > files;
+        bool bigEndian;
+        bool swapWords; // true if the memory byte order differs from the host's
+
+        // the most recently used page, which almost every access hits
+        unsigned int lastPageNumber;
+        unsigned char *lastPage;
+        bool lastPageModified; // false for a mapped page that hasn't been written
+
+        unsigned char *findPage(unsigned int pageNumber);
+        unsigned char *allocatePage(unsigned int pageNumber);
+        page_table *findTable(unsigned int pageNumber);
+        void setPage(unsigned int pageNumber, unsigned char *bytes, bool mapped);
+        void revertPage(page_table *table, unsigned int entry);
+        unsigned char readByte(unsigned int address);
+        void writeByte(unsigned int address, unsigned char value);
 };
 
 #endif // DATAMEMORY_H
@@ -0,0 +1,153 @@
+/*************************************************************************
+ * Decoder.cpp
+ *
+ * This file contains the implementation of the instruction decoder
+ * for the pipelined machine defined in "Computer Organization and
+ * Design, the Hardware Software Interface", Patterson & Hennessy, Fifth Edition.
+ *
+ * This code was developed as a demonstration for SER450 and is provided
+ * as-is as a learning aid for Chapter 4 of the class text.
+ *
+ * COPYRIGHT (C) 2019, Arizona State University
+ * ALL RIGHTS RESERVED
+ *
+ **************************************************************************/
+#include <stdio.h>
+#include <array>
+#include "Decoder.h"
+
+// the instruction set.  Each line gives the control signals that the
+// control unit and ALU control unit produce for the instruction.
+static constexpr InstructionDefinition instructionSet[] = {
+    {"lw", OP_LW, NO_FUNCT, FORMAT_MEMORY, 0x2, CTL_ALUSRC | CTL_MEMREAD | CTL_MEMTOREG | CTL_REGWRITE, 0},
+    {"sw", OP_SW, NO_FUNCT, FORMAT_MEMORY, 0x2, CTL_ALUSRC | CTL_MEMWRITE, 0},
+    {"beq", OP_BEQ, NO_FUNCT, FORMAT_BRANCH, 0x6, CTL_BRANCH, 0},
+    {"j", OP_JMP, NO_FUNCT, FORMAT_JUMP, 0x2, CTL_JUMP, 0},
+    {"add", OP_RTYPE, 0x20, FORMAT_REGISTER, 0x2, CTL_REGDST | CTL_REGWRITE, 0},
+    {"sub", OP_RTYPE, 0x22, FORMAT_REGISTER, 0x6, CTL_REGDST | CTL_REGWRITE, 0},
+    {"and", OP_RTYPE, 0x24, FORMAT_REGISTER, 0x0, CTL_REGDST | CTL_REGWRITE, 0},
+    {"or", OP_RTYPE, 0x25, FORMAT_REGISTER, 0x1, CTL_REGDST | CTL_REGWRITE, 0},
+    {"slt", OP_RTYPE, 0x2a, FORMAT_REGISTER, 0x7, CTL_REGDST | CTL_REGWRITE, 0},
+    {"break", OP_RTYPE, FUNCT_BREAK, FORMAT_NONE, 0xf, CTL_REGDST, 1}, // halts, and otherwise has no effect
+};
+static constexpr unsigned int instructionCount = sizeof(instructionSet) / sizeof(instructionSet[0]);
+
+// the decoder's lookup tables, one indexed by opcode and one by the funct
+// field of r-type instructions, generated from the instruction set
+#define NO_DEFINITION 0xff
+
+typedef struct
+{
+    unsigned char aluOperation;
+    unsigned char control;
+    unsigned char halt;
+    unsigned char definition; // index into instructionSet, or NO_DEFINITION
+} decode_entry;
+
+typedef std::array<decode_entry, 64> decode_table;
+
+static constexpr decode_table makeDecodeTable(bool rtype)
+{
+    // the control unit treats an undefined opcode like a load or store with
+    // no control signals, and the ALU control unit gives an undefined
+    // r-type function the ALU operation 0xf, which produces 0
+    decode_table table = {};
+    for (unsigned int i = 0; i < 64; i++)
+        table[i] = rtype ? decode_entry{0xf, CTL_REGDST | CTL_REGWRITE, 0, NO_DEFINITION}
+                         : decode_entry{0x2, 0, 0, NO_DEFINITION};
+    for (unsigned int i = 0; i < instructionCount; i++)
+    {
+        const InstructionDefinition &definition = instructionSet[i];
+        if ((definition.opcode == OP_RTYPE) != rtype)
+            continue;
+        unsigned int index = rtype ? definition.funct : definition.opcode;
+        table[index] = decode_entry{definition.aluOperation, definition.control, definition.halt, (unsigned char)i};
+    }
+    return table;
+}
+
+// true if no two definitions claim the same encoding
+static constexpr bool uniqueEncodings()
+{
+    for (unsigned int i = 0; i < instructionCount; i++)
+        for (unsigned int j = i + 1; j < instructionCount; j++)
+            if ((instructionSet[i].opcode == instructionSet[j].opcode) &&
+                (instructionSet[i].funct == instructionSet[j].funct))
+                return false;
+    return true;
+}
+static_assert(uniqueEncodings(), "two instructions share an encoding");
+
+static constexpr decode_table opcodeTable = makeDecodeTable(false);
+static constexpr decode_table functTable = makeDecodeTable(true);
+
+static const char *const registerNames[32] = {
+    "$zero", "$at", "$v0", "$v1", "$a0", "$a1", "$a2", "$a3",
+    "$t0", "$t1", "$t2", "$t3", "$t4", "$t5", "$t6", "$t7",
+    "$s0", "$s1", "$s2", "$s3", "$s4", "$s5", "$s6", "$s7",
+    "$t8", "$t9", "$k0", "$k1", "$gp", "$sp", "$fp", "$ra"};
+
+//********************************************
+// decodeInstruction
+// extract the fields from an instruction word and
+// look up the control signals that the ID stage
+// would generate for it.
+void decodeInstruction(unsigned int instruction, DecodedInstruction &decoded)
+{
+    // extract the fields from the instruction
+    unsigned int opcode = BITS(instruction, 26, 31);
+    unsigned int funct = BITS(instruction, 0, 5);
+    const decode_entry &entry = (opcode == OP_RTYPE) ? functTable[funct] : opcodeTable[opcode];
+
+    decoded.opcode = opcode;
+    decoded.funct = funct;
+    decoded.aluOperation = entry.aluOperation;
+    decoded.control = entry.control;
+    decoded.rs = BITS(instruction, 21, 25);
+    decoded.rt = BITS(instruction, 16, 20);
+    decoded.rd = BITS(instruction, 11, 15);
+    decoded.halt = entry.halt;
+    decoded.immed_se = SIGN_EXT(BITS(instruction, 0, 15));
+    decoded.jmpaddr = BITS(instruction, 0, 25);
+}
+
+//********************************************
+// findInstruction
+const InstructionDefinition *findInstruction(unsigned int instruction)
+{
+    unsigned int opcode = BITS(instruction, 26, 31);
+    const decode_entry &entry = (opcode == OP_RTYPE) ? functTable[BITS(instruction, 0, 5)] : opcodeTable[opcode];
+    return (entry.definition == NO_DEFINITION) ? 0 : &instructionSet[entry.definition];
+}
+
+const InstructionDefinition *instructionDefinition(unsigned int index)
+{
+    return (index < instructionCount) ? &instructionSet[index] : 0;
+}
+
+//********************************************
+// disassemble
+char *disassemble(unsigned int instruction, char *text, unsigned int size)
+{
+    const InstructionDefinition *definition = findInstruction(instruction);
+    const char *rs = registerNames[BITS(instruction, 21, 25)];
+    const char *rt = registerNames[BITS(instruction, 16, 20)];
+    const char *rd = registerNames[BITS(instruction, 11, 15)];
+    int immed = (int)SIGN_EXT(BITS(instruction, 0, 15));
+    if (instruction == 0)
+        snprintf(text, size, "nop");
+    else if (!definition)
+        snprintf(text, size, ".word 0x%08x", instruction);
+    else if (definition->format == FORMAT_REGISTER)
+        snprintf(text, size, "%s %s, %s, %s", definition->mnemonic, rd, rs, rt);
+    else if (definition->format == FORMAT_MEMORY)
+        snprintf(text, size, "%s %s, %s0x%x(%s)", definition->mnemonic, rt, (immed < 0) ? "-" : "",
+                 (immed < 0) ? -immed : immed, rs);
+    else if (definition->format == FORMAT_BRANCH)
+        snprintf(text, size, "%s %s, %s, %d", definition->mnemonic, rs, rt, immed);
+    else if (definition->format == FORMAT_JUMP)
+        snprintf(text, size, "%s 0x%08x", definition->mnemonic, BITS(instruction, 0, 25) << 2);
+    else
+        snprintf(text, size, "%s", definition->mnemonic);
+    return text;
+}
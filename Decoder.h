@@ -0,0 +1,109 @@
+/*************************************************************************
+ * Decoder.h
+ *
+ * This file contains the definition of the predecoded instruction record
+ * and the instruction decoder for the pipelined machine defined in
+ * "Computer Organization and Design, the Hardware Software Interface",
+ * Patterson & Hennessy, Fifth Edition.
+ *
+ * This code was developed as a demonstration for SER450 and is provided
+ * as-is as a learning aid for Chapter 4 of the class text.
+ *
+ * COPYRIGHT (C) 2019, Arizona State University
+ * ALL RIGHTS RESERVED
+ *
+ **************************************************************************/
+#ifndef DECODER_H
+#define DECODER_H
+
+// BITS(x, start, end) a macro function that takes three integer arguments
+//    the output of the function will be bits start-end of of value x but
+//    the bits in the output will be shifted so that bit start is at bit
+//    position 0.  Example: the input values 0x12345678, 8,12 will yield
+//    the result 0x00000006
+#define BITS(x, start, end) ((x >> start) & ((1 << (end - start + 1)) - 1))
+
+// SIGN_EXT(x) a macro to sign extend a 16 bit signed integer to 32 bits
+#define SIGN_EXT(x) ((x & 0x8000) ? (0xffff0000 | x) : x)
+
+// each of the following are the opcodes for teh specified instruction from
+// the MIPS instruction set.
+#define OP_LW 0x23
+#define OP_SW 0x2B
+#define OP_RTYPE 0x00
+#define OP_BEQ 0x04
+#define OP_JMP 0x02
+
+// the function code of the break instruction, which halts the machine
+#define FUNCT_BREAK 0x0d
+
+// bit masks for the control signals held in DecodedInstruction::control
+#define CTL_REGWRITE 0x01
+#define CTL_MEMTOREG 0x02
+#define CTL_MEMREAD 0x04
+#define CTL_MEMWRITE 0x08
+#define CTL_REGDST 0x10
+#define CTL_ALUSRC 0x20
+#define CTL_BRANCH 0x40
+#define CTL_JUMP 0x80
+
+// DecodedInstruction
+// the output of the instruction decode combinational logic for a single
+// instruction word.  Since the contents of instruction memory do not change
+// while the program runs, this record is computed once when the word is
+// placed in instruction memory rather than on every pass through the ID stage.
+typedef struct
+{
+    unsigned char opcode;
+    unsigned char funct;
+    unsigned char aluOperation; // the ALU control lines (ALUControl)
+    unsigned char control;      // CTL_xxx control signals
+    unsigned char rs;
+    unsigned char rt;
+    unsigned char rd;
+    unsigned char halt;         // nonzero for the break instruction
+    unsigned int immed_se;      // the sign extended immediate field
+    unsigned int jmpaddr;       // the 26-bit jump target field
+} DecodedInstruction;
+
+// the ways an instruction's operands are written in assembly language
+#define FORMAT_REGISTER 0 // op $rd, $rs, $rt
+#define FORMAT_MEMORY 1   // op $rt, immediate($rs)
+#define FORMAT_BRANCH 2   // op $rs, $rt, offset
+#define FORMAT_JUMP 3     // op target
+#define FORMAT_NONE 4     // op
+
+// the marker for an instruction that is selected by its opcode alone
+#define NO_FUNCT 0xff
+
+// InstructionDefinition
+// one entry of the instruction set table, which is the single description
+// of every instruction the machine implements.  The decoder's lookup
+// tables and the disassembler are generated from it, so adding an
+// instruction is a matter of adding its line to the table in Decoder.cpp.
+typedef struct
+{
+    const char *mnemonic;
+    unsigned char opcode;
+    unsigned char funct;        // NO_FUNCT unless opcode is OP_RTYPE
+    unsigned char format;       // FORMAT_xxx
+    unsigned char aluOperation; // the ALU control lines (ALUControl)
+    unsigned char control;      // CTL_xxx control signals
+    unsigned char halt;         // nonzero for the break instruction
+} InstructionDefinition;
+
+// decode the fields and control signals for an instruction word
+void decodeInstruction(unsigned int instruction, DecodedInstruction &decoded);
+
+// the definition of an instruction word, or 0 if the machine doesn't
+// define it.  The instruction set table can be walked by index, and
+// instructionDefinition returns 0 past the end.
+const InstructionDefinition *findInstruction(unsigned int instruction);
+const InstructionDefinition *instructionDefinition(unsigned int index);
+
+// write the assembly language form of an instruction word into text,
+// returning text.  Words the machine doesn't define are written as
+// ".word 0x...".
+char *disassemble(unsigned int instruction, char *text, unsigned int size);
+
+#endif // DECODER_H
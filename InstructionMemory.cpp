@@ -16,17 +16,83 @@
 **************************************************************************/
 #include "InstructionMemory.h"
 
+InstructionMemory::InstructionMemory()
+{
+    changes = 0;
+    words = 0;
+    decodedWords = 0;
+    count = 0;
+
+    // start with room for 2048 nop instructions
+    decodeInstruction(0, nop);
+    reserve(2048);
+}
+
+void InstructionMemory::reserve(unsigned int size)
+{
+    detach();
+    if (size > memory.size()) {
+        memory.resize(size, 0);
+        decodedMemory.resize(size, nop);
+    }
+    words = memory.data();
+    decodedWords = decodedMemory.data();
+    count = memory.size();
+}
+
+void InstructionMemory::attach(const unsigned int *attachedWords, const DecodedInstruction *decoded, unsigned int words_count)
+// point the memory at words stored elsewhere.  Nothing is copied unless the words
+// must be decoded, so attaching a large mapped image costs nothing up front.
+{
+    memory.clear();
+    decodedMemory.clear();
+    if (!decoded) {
+        decodedMemory.resize(words_count);
+        for (unsigned int i = 0; i < words_count; i++) decodeInstruction(attachedWords[i], decodedMemory[i]);
+        decoded = decodedMemory.data();
+    }
+    words = attachedWords;
+    decodedWords = decoded;
+    count = words_count;
+    changes++;
+}
+
+void InstructionMemory::detach()
+// take a private copy of attached storage so that it can be changed
+{
+    if (words == memory.data()) return;
+    memory.assign(words, words + count);
+    if (decodedWords != decodedMemory.data()) decodedMemory.assign(decodedWords, decodedWords + count);
+    words = memory.data();
+    decodedWords = decodedMemory.data();
+}
+
 void InstructionMemory::setAt(unsigned int addr, unsigned int value)
 // this function is not part of the single-cycle machine architecture, but can be used to
 // load program code into instruction memory
 {
     addr = addr>>2;
+    detach();
+    if (addr >= memory.size()) reserve(addr < memory.size()*2 ? memory.size()*2 : addr+1);
     memory[addr]=value;
+
+    // the predecoded copy of this word is now stale - decode it again
+    decodeInstruction(value, decodedMemory[addr]);
+    changes++;
 }
 
-unsigned int InstructionMemory::value(unsigned int addr)
+unsigned int InstructionMemory::value(unsigned int addr) const
 // return the entire integer representation of the instruction at a specified memory location
 {
     addr = addr>>2;
-    return memory[addr];
+    if (addr >= count) return 0;
+    return words[addr];
+}
+
+const DecodedInstruction &InstructionMemory::decoded(unsigned int addr) const
+// return the predecoded control signals for the instruction at a specified memory location
+{
+    addr = addr>>2;
+    if (addr >= count) return nop;
+    return decodedWords[addr];
 }
@@ -16,13 +16,38 @@
 **************************************************************************/
 #ifndef INSTRUCTIONMEMORY_H_INCLUDED
 #define INSTRUCTIONMEMORY_H_INCLUDED
+#include <vector>
+#include "Decoder.h"
 
 class InstructionMemory {
 public:
-    unsigned int value(unsigned int pc);
+    InstructionMemory();
+    unsigned int value(unsigned int pc) const;
+    const DecodedInstruction &decoded(unsigned int pc) const; // the predecoded form of value(pc)
     void setAt(unsigned int addr, unsigned int value);
+    unsigned int version() const { return changes; } // changes each time setAt is called
+    void reserve(unsigned int words); // make room for the specified number of words
+    unsigned int size() const { return count; } // the number of words held
+
+    // use words held elsewhere (for example in a mapped image file) as the
+    // contents of memory.  If decoded is null the words are decoded here.
+    // The storage must outlive this memory or the next call to setAt, which
+    // takes a private copy before changing anything.
+    void attach(const unsigned int *words, const DecodedInstruction *decoded, unsigned int words_count);
 private:
-    unsigned int memory[2048];
+    // the memory grows to hold the highest address written; addresses
+    // beyond that read as nop instructions
+    unsigned int changes;
+    std::vector<unsigned int> memory;
+    std::vector<DecodedInstruction> decodedMemory; // kept in step with memory by setAt
+    DecodedInstruction nop;
+
+    // the words currently in use: either the vectors above or attached storage
+    const unsigned int *words;
+    const DecodedInstruction *decodedWords;
+    unsigned int count;
+
+    void detach();
 
 };
 
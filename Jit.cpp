@@ -0,0 +1,389 @@
+/*************************************************************************
+ * Jit.cpp
+ *
+ * This file contains the class implementation for the dynamic binary
+ * translator used by the functional model of the CPU.
+ *
+ * Translated code keeps the following values in callee-saved registers:
+ *    rbx - pointer to the register file contents (RegisterFile layout)
+ *    r12 - pointer to the DataMemory object
+ *    r13 - pointer to the jit_context for this call to execute()
+ *    r14 - remaining instruction budget
+ *    r15 - the stop pc
+ *    rbp - the branch condition (computed before the delay slot runs)
+ * and returns the address of the next instruction in eax.
+ *
+ * This code was developed as a demonstration for SER450 and is provided
+ * as-is as a learning aid for Chapter 4 of the class text.
+ *
+ * COPYRIGHT (C) 2019, Arizona State University
+ * ALL RIGHTS RESERVED
+ *
+ **************************************************************************/
+#include "Jit.h"
+#include "DataMemory.h"
+
+#if JIT_SUPPORTED
+#include <sys/mman.h>
+#endif
+
+// the size of the executable code buffer
+#ifndef JIT_BUFFER_SIZE
+#define JIT_BUFFER_SIZE (16 * 1024 * 1024)
+#endif
+
+// an upper bound on the bytes of native code emitted per instruction,
+// used to make sure a block fits in the remaining buffer space
+#define JIT_MAX_BYTES_PER_INSTRUCTION 64
+
+// the state passed from execute() to the entry stub
+typedef struct
+{
+    unsigned int *regs;           // offset 0
+    DataMemory *dmem;             // offset 8
+    unsigned long long budget;    // offset 16
+    unsigned int stopPc;          // offset 24
+} jit_context;
+
+// data memory accesses made by translated code
+static unsigned int jitLoad(DataMemory *dmem, unsigned int address)
+{
+    return dmem->read(address, true);
+}
+
+static void jitStore(DataMemory *dmem, unsigned int address, unsigned int data)
+{
+    dmem->update(address, data, true);
+}
+
+//********************************************
+// Constructor
+Jit::Jit()
+    : buffer(0), size(0), used(0), codeStart(0), generation(0), enterStub(0), exitStub(0)
+{
+#if JIT_SUPPORTED
+    void *memory = mmap(0, JIT_BUFFER_SIZE, PROT_READ | PROT_WRITE | PROT_EXEC,
+                        MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (memory == MAP_FAILED)
+        return;
+    buffer = (unsigned char *)memory;
+    size = JIT_BUFFER_SIZE;
+    emitStubs();
+#endif
+}
+
+//********************************************
+// Destructor
+Jit::~Jit()
+{
+#if JIT_SUPPORTED
+    if (buffer)
+        munmap(buffer, size);
+#endif
+}
+
+//********************************************
+// byte emission helpers
+void Jit::emit8(unsigned int value)
+{
+    buffer[used++] = value & 0xff;
+}
+
+void Jit::emit32(unsigned int value)
+{
+    emit8(value);
+    emit8(value >> 8);
+    emit8(value >> 16);
+    emit8(value >> 24);
+}
+
+void Jit::emit64(unsigned long long value)
+{
+    emit32((unsigned int)value);
+    emit32((unsigned int)(value >> 32));
+}
+
+void Jit::patchRel32(unsigned int offset, unsigned char *target)
+{
+    unsigned int rel = (unsigned int)(target - (buffer + offset + 4));
+    buffer[offset] = rel & 0xff;
+    buffer[offset + 1] = (rel >> 8) & 0xff;
+    buffer[offset + 2] = (rel >> 16) & 0xff;
+    buffer[offset + 3] = (rel >> 24) & 0xff;
+}
+
+// jmp rel32
+void Jit::emitJump(unsigned char *target)
+{
+    emit8(0xe9);
+    emit32(0);
+    patchRel32(used - 4, target);
+}
+
+//********************************************
+// emitStubs
+// emit the code that enters translated code from
+// execute() and the code that returns to it.
+void Jit::emitStubs()
+{
+    used = 0;
+
+    // entry: rdi = jit_context, rsi = block to run
+    enterStub = buffer + used;
+    emit8(0x53);                           // push rbx
+    emit8(0x55);                           // push rbp
+    emit8(0x41); emit8(0x54);              // push r12
+    emit8(0x41); emit8(0x55);              // push r13
+    emit8(0x41); emit8(0x56);              // push r14
+    emit8(0x41); emit8(0x57);              // push r15
+    emit8(0x48); emit8(0x83); emit8(0xec); emit8(0x08); // sub rsp, 8 (keep the stack 16-byte aligned)
+    emit8(0x49); emit8(0x89); emit8(0xfd); // mov r13, rdi
+    emit8(0x48); emit8(0x8b); emit8(0x1f); // mov rbx, [rdi]
+    emit8(0x4c); emit8(0x8b); emit8(0x67); emit8(0x08); // mov r12, [rdi + 8]
+    emit8(0x4c); emit8(0x8b); emit8(0x77); emit8(0x10); // mov r14, [rdi + 16]
+    emit8(0x44); emit8(0x8b); emit8(0x7f); emit8(0x18); // mov r15d, [rdi + 24]
+    emit8(0xff); emit8(0xe6);              // jmp rsi
+
+    // exit: eax = next pc
+    exitStub = buffer + used;
+    emit8(0x4d); emit8(0x89); emit8(0x75); emit8(0x10); // mov [r13 + 16], r14
+    emit8(0x48); emit8(0x83); emit8(0xc4); emit8(0x08); // add rsp, 8
+    emit8(0x41); emit8(0x5f);              // pop r15
+    emit8(0x41); emit8(0x5e);              // pop r14
+    emit8(0x41); emit8(0x5d);              // pop r13
+    emit8(0x41); emit8(0x5c);              // pop r12
+    emit8(0x5d);                           // pop rbp
+    emit8(0x5b);                           // pop rbx
+    emit8(0xc3);                           // ret
+
+    codeStart = used;
+}
+
+//********************************************
+// flush
+// discard all translated code
+void Jit::flush()
+{
+    used = codeStart;
+    blocks.clear();
+    pendingExits.clear();
+    generation++;
+}
+
+//********************************************
+// lookup
+void *Jit::lookup(unsigned int pc)
+{
+    std::unordered_map<unsigned int, unsigned char *>::iterator it = blocks.find(pc);
+    if (it == blocks.end())
+        return 0;
+    return it->second;
+}
+
+//********************************************
+// emitExit
+// leave the block and continue at targetPc.  If the
+// target block has already been translated, jump
+// straight to it, otherwise return to execute() and
+// remember where the jump is so that it can be chained
+// once the target is translated.
+void Jit::emitExit(unsigned int targetPc)
+{
+    emit8(0xb8); // mov eax, targetPc
+    emit32(targetPc);
+
+    unsigned char *target = (unsigned char *)lookup(targetPc);
+    if (target)
+    {
+        emitJump(target);
+        return;
+    }
+    emitJump(exitStub);
+    patch_site site = {used - 4};
+    pendingExits[targetPc].push_back(site);
+}
+
+//********************************************
+// emitInstruction
+// emit the native code for a non-control-flow
+// instruction.  Instructions that neither write a
+// register nor memory have no effect and emit nothing.
+void Jit::emitInstruction(const DecodedInstruction &decoded)
+{
+    if (!(decoded.control & (CTL_REGWRITE | CTL_MEMWRITE)))
+        return;
+
+    // eax = operand 1, ecx = operand 2
+    emit8(0x8b); emit8(0x43); emit8(decoded.rs * 4); // mov eax, [rbx + rs*4]
+    if (decoded.control & CTL_ALUSRC)
+    {
+        emit8(0xb9); // mov ecx, immed
+        emit32(decoded.immed_se);
+    }
+    else
+    {
+        emit8(0x8b); emit8(0x4b); emit8(decoded.rt * 4); // mov ecx, [rbx + rt*4]
+    }
+
+    // the ALU (see Cpu::alu)
+    switch (decoded.aluOperation)
+    {
+    case 0x0:
+        emit8(0x21); emit8(0xc8); // and eax, ecx
+        break;
+    case 0x1:
+        emit8(0x09); emit8(0xc8); // or eax, ecx
+        break;
+    case 0x2:
+        emit8(0x01); emit8(0xc8); // add eax, ecx
+        break;
+    case 0x6:
+        emit8(0x29); emit8(0xc8); // sub eax, ecx
+        break;
+    case 0x7:
+        emit8(0x39); emit8(0xc8);              // cmp eax, ecx
+        emit8(0x0f); emit8(0x92); emit8(0xc0); // setb al
+        emit8(0x0f); emit8(0xb6); emit8(0xc0); // movzx eax, al
+        break;
+    case 0xc:
+        emit8(0x09); emit8(0xc8); // or eax, ecx
+        emit8(0xf7); emit8(0xd0); // not eax
+        break;
+    default:
+        emit8(0x31); emit8(0xc0); // xor eax, eax
+        break;
+    }
+
+    if (decoded.control & CTL_MEMWRITE)
+    {
+        emit8(0x4c); emit8(0x89); emit8(0xe7);           // mov rdi, r12
+        emit8(0x89); emit8(0xc6);                        // mov esi, eax
+        emit8(0x8b); emit8(0x53); emit8(decoded.rt * 4); // mov edx, [rbx + rt*4]
+        emit8(0x48); emit8(0xb8);                        // mov rax, jitStore
+        emit64((unsigned long long)&jitStore);
+        emit8(0xff); emit8(0xd0);                        // call rax
+    }
+
+    if (decoded.control & CTL_REGWRITE)
+    {
+        if (decoded.control & CTL_MEMTOREG)
+        {
+            emit8(0x4c); emit8(0x89); emit8(0xe7); // mov rdi, r12
+            emit8(0x89); emit8(0xc6);              // mov esi, eax
+            emit8(0x48); emit8(0xb8);              // mov rax, jitLoad
+            emit64((unsigned long long)&jitLoad);
+            emit8(0xff); emit8(0xd0);              // call rax
+        }
+        unsigned int regWrAddr = (decoded.control & CTL_REGDST) ? decoded.rd : decoded.rt;
+        emit8(0x89); emit8(0x43); emit8(regWrAddr * 4); // mov [rbx + dest*4], eax
+    }
+}
+
+//********************************************
+// translate
+// emit native code for a basic block from the
+// block cache
+void *Jit::translate(const Block &block)
+{
+    if (!buffer)
+        return 0;
+    unsigned int pc = block.startPc;
+    unsigned int count = block.ops.size();
+
+    // make sure the block will fit, starting over if it will not
+    unsigned int needed = (count + 4) * JIT_MAX_BYTES_PER_INSTRUCTION;
+    if (codeStart + needed > size)
+        return 0;
+    if (used + needed > size)
+        flush();
+
+    unsigned char *entry = buffer + used;
+
+    // stop if the stop pc is anywhere in the block (blocks reached by
+    // chaining are entered without the Cpu's check), or if the budget is
+    // too small for the whole block
+    unsigned int bailSite[2];
+    emit8(0x44); emit8(0x89); emit8(0xf8);                // mov eax, r15d
+    emit8(0x2d); emit32(pc);                              // sub eax, pc
+    emit8(0xc1); emit8(0xe8); emit8(0x02);                // shr eax, 2
+    emit8(0x3d); emit32(count);                           // cmp eax, count
+    emit8(0x0f); emit8(0x82); emit32(0);                  // jb bail
+    bailSite[0] = used - 4;
+    emit8(0x49); emit8(0x81); emit8(0xfe); emit32(count); // cmp r14, count
+    emit8(0x0f); emit8(0x82); emit32(0);                  // jb bail
+    bailSite[1] = used - 4;
+    emit8(0x49); emit8(0x81); emit8(0xee); emit32(count); // sub r14, count
+
+    // the straight line part of the block
+    unsigned int straight = block.endsWithControl ? count - 2 : count;
+    for (unsigned int i = 0; i < straight; i++)
+        emitInstruction(block.ops[i]);
+
+    if (!block.endsWithControl)
+    {
+        // the block was too long - fall through to the next one
+        emitExit(block.fallthroughPc);
+    }
+    else
+    {
+        const DecodedInstruction &control = block.ops[count - 2];
+        if (control.control & CTL_BRANCH)
+        {
+            // the equality unit compares the registers before the delay slot runs
+            emit8(0x8b); emit8(0x43); emit8(control.rs * 4); // mov eax, [rbx + rs*4]
+            emit8(0x3b); emit8(0x43); emit8(control.rt * 4); // cmp eax, [rbx + rt*4]
+            emit8(0x0f); emit8(0x94); emit8(0xc0);           // sete al
+            emit8(0x0f); emit8(0xb6); emit8(0xe8);           // movzx ebp, al
+            emitInstruction(block.ops[count - 1]);
+
+            emit8(0x85); emit8(0xed);             // test ebp, ebp
+            emit8(0x0f); emit8(0x84); emit32(0);  // jz not_taken
+            unsigned int notTakenSite = used - 4;
+            emitExit(block.takenPc);
+            patchRel32(notTakenSite, buffer + used);
+            emitExit(block.fallthroughPc);
+        }
+        else
+        {
+            emitInstruction(block.ops[count - 1]);
+            emitExit(block.takenPc);
+        }
+    }
+
+    // bail out without running any of the block
+    patchRel32(bailSite[0], buffer + used);
+    patchRel32(bailSite[1], buffer + used);
+    emit8(0xb8); // mov eax, pc
+    emit32(pc);
+    emitJump(exitStub);
+
+    // chain any blocks that were waiting for this one
+    blocks[pc] = entry;
+    std::unordered_map<unsigned int, std::vector<patch_site> >::iterator it = pendingExits.find(pc);
+    if (it != pendingExits.end())
+    {
+        for (unsigned int i = 0; i < it->second.size(); i++)
+            patchRel32(it->second[i].offset, entry);
+        pendingExits.erase(it);
+    }
+    return entry;
+}
+
+//********************************************
+// execute
+// run translated code through the entry stub
+unsigned int Jit::execute(void *code, unsigned int *regs, DataMemory *dmem,
+                          unsigned long long &budget, unsigned int stopPc)
+{
+    typedef unsigned int (*enter_function)(jit_context *context, void *code);
+
+    jit_context context;
+    context.regs = regs;
+    context.dmem = dmem;
+    context.budget = budget;
+    context.stopPc = stopPc;
+
+    unsigned int nextPc = ((enter_function)enterStub)(&context, code);
+    budget = context.budget;
+    return nextPc;
+}
@@ -0,0 +1,97 @@
+/*************************************************************************
+ * Jit.h
+ *
+ * This file contains the class definition for the dynamic binary
+ * translator used by the functional model of the CPU.  Hot basic blocks
+ * of MIPS code are translated into native x86-64 code that operates
+ * directly on the register file and calls into the data memory for
+ * loads and stores.
+ *
+ * This code was developed as a demonstration for SER450 and is provided
+ * as-is as a learning aid for Chapter 4 of the class text.
+ *
+ * COPYRIGHT (C) 2019, Arizona State University
+ * ALL RIGHTS RESERVED
+ *
+ **************************************************************************/
+#ifndef JIT_H
+#define JIT_H
+#include <unordered_map>
+#include <vector>
+#include "BlockCache.h"
+#include "Decoder.h"
+
+// native code generation is only supported for x86-64 hosts that use
+// the System V calling convention
+#if defined(__x86_64__) && !defined(_WIN32)
+#define JIT_SUPPORTED 1
+#else
+#define JIT_SUPPORTED 0
+#endif
+
+class DataMemory;
+
+class Jit
+{
+public:
+    Jit();
+    ~Jit();
+
+    // true if translated code can be run on this host
+    bool available() const { return buffer != 0; }
+
+    // return the translated code for the block that starts at pc, or
+    // 0 if the block has not been translated
+    void *lookup(unsigned int pc);
+
+    // translate a basic block to native code and return its entry point,
+    // or 0 if it cannot be translated.  Translating may flush the buffer,
+    // which makes the code of every earlier generation stale.
+    void *translate(const Block &block);
+
+    // incremented each time translated code is discarded
+    unsigned int getGeneration() const { return generation; }
+
+    // run translated code starting with the specified block.  Blocks are
+    // chained together until the instruction budget would be exceeded,
+    // a block containing stopPc is reached, or a block that has not been
+    // translated is reached.  The budget is reduced by the number of
+    // instructions executed.  Returns the address of the next instruction.
+    unsigned int execute(void *code, unsigned int *regs, DataMemory *dmem,
+                         unsigned long long &budget, unsigned int stopPc);
+
+    // discard all translated code
+    void flush();
+
+private:
+    // a location in translated code holding the rel32 operand of a
+    // jump to the exit stub that can be re-pointed at a translated block
+    typedef struct
+    {
+        unsigned int offset;
+    } patch_site;
+
+    unsigned char *buffer; // executable memory for translated code
+    unsigned int size;
+    unsigned int used;
+    unsigned int codeStart; // the first byte after the entry/exit stubs
+    unsigned int generation;
+    unsigned char *enterStub;
+    unsigned char *exitStub;
+
+    std::unordered_map<unsigned int, unsigned char *> blocks;
+    std::unordered_map<unsigned int, std::vector<patch_site> > pendingExits;
+
+    void emitStubs();
+    void emitExit(unsigned int targetPc);
+    void emitInstruction(const DecodedInstruction &decoded);
+    void emitJump(unsigned char *target);
+
+    // byte emission helpers
+    void emit8(unsigned int value);
+    void emit32(unsigned int value);
+    void emit64(unsigned long long value);
+    void patchRel32(unsigned int offset, unsigned char *target);
+};
+
+#endif // JIT_H
@@ -0,0 +1,285 @@
+/*************************************************************************
+ * Lockstep.cpp
+ *
+ * This file contains the class implementation for the lockstep
+ * functional model.
+ *
+ * This code was developed as a demonstration for SER450 and is provided
+ * as-is as a learning aid for Chapter 4 of the class text.
+ *
+ * COPYRIGHT (C) 2019, Arizona State University
+ * ALL RIGHTS RESERVED
+ *
+ **************************************************************************/
+#include "Lockstep.h"
+#include "BlockCache.h"
+#include "Decoder.h"
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#define LOCKSTEP_AVX2 1
+#else
+#define LOCKSTEP_AVX2 0
+#endif
+
+// The group helpers below each work on LOCKSTEP_GROUP lanes.  A mask
+// holds all ones for a lane that takes part and zero for one that doesn't.
+
+#if LOCKSTEP_AVX2
+static inline __m256i loadGroup(const unsigned int *p)
+{
+    return _mm256_loadu_si256((const __m256i *)p);
+}
+
+static inline void storeGroup(unsigned int *p, __m256i value)
+{
+    _mm256_storeu_si256((__m256i *)p, value);
+}
+#endif
+
+// out = the ALU operation on a and b, as Cpu::alu computes it
+static inline void aluGroup(unsigned int ALUControl, const unsigned int *a, const unsigned int *b, unsigned int *out)
+{
+#if LOCKSTEP_AVX2
+    __m256i va = loadGroup(a);
+    __m256i vb = loadGroup(b);
+    __m256i r;
+    switch (ALUControl)
+    {
+    case 0x0:
+        r = _mm256_and_si256(va, vb); // and
+        break;
+    case 0x1:
+        r = _mm256_or_si256(va, vb); // or
+        break;
+    case 0x2:
+        r = _mm256_add_epi32(va, vb); // add
+        break;
+    case 0x6:
+        r = _mm256_sub_epi32(va, vb); // subtract
+        break;
+    case 0x7:
+    {
+        // set less than, comparing unsigned values with a signed compare
+        __m256i bias = _mm256_set1_epi32(0x80000000);
+        __m256i less = _mm256_cmpgt_epi32(_mm256_xor_si256(vb, bias), _mm256_xor_si256(va, bias));
+        r = _mm256_and_si256(less, _mm256_set1_epi32(1));
+        break;
+    }
+    case 0xc:
+        r = _mm256_xor_si256(_mm256_or_si256(va, vb), _mm256_set1_epi32(-1)); // nor
+        break;
+    default:
+        r = _mm256_setzero_si256();
+    }
+    storeGroup(out, r);
+#else
+    for (unsigned int i = 0; i < LOCKSTEP_GROUP; i++)
+    {
+        unsigned int r = 0;
+        if (ALUControl == 0x0)
+            r = a[i] & b[i];
+        if (ALUControl == 0x1)
+            r = a[i] | b[i];
+        if (ALUControl == 0x2)
+            r = a[i] + b[i];
+        if (ALUControl == 0x6)
+            r = a[i] - b[i];
+        if (ALUControl == 0x7)
+            r = (a[i] < b[i]) ? 1 : 0;
+        if (ALUControl == 0xc)
+            r = ~(a[i] | b[i]);
+        out[i] = r;
+    }
+#endif
+}
+
+// row = value in the lanes of mask, unchanged elsewhere
+static inline void blendGroup(unsigned int *row, const unsigned int *value, const unsigned int *mask)
+{
+#if LOCKSTEP_AVX2
+    storeGroup(row, _mm256_blendv_epi8(loadGroup(row), loadGroup(value), loadGroup(mask)));
+#else
+    for (unsigned int i = 0; i < LOCKSTEP_GROUP; i++)
+        row[i] = (value[i] & mask[i]) | (row[i] & ~mask[i]);
+#endif
+}
+
+// mask = the running lanes whose pc is leader.  Returns how many there are.
+static inline unsigned int selectGroup(unsigned int *mask, const unsigned int *active, const unsigned int *pcs,
+                                       unsigned int leader)
+{
+#if LOCKSTEP_AVX2
+    __m256i m = _mm256_and_si256(loadGroup(active), _mm256_cmpeq_epi32(loadGroup(pcs), _mm256_set1_epi32(leader)));
+    storeGroup(mask, m);
+    return __builtin_popcount(_mm256_movemask_ps(_mm256_castsi256_ps(m)));
+#else
+    unsigned int count = 0;
+    for (unsigned int i = 0; i < LOCKSTEP_GROUP; i++)
+    {
+        mask[i] = (pcs[i] == leader) ? active[i] : 0;
+        count += mask[i] & 1;
+    }
+    return count;
+#endif
+}
+
+// advance the pc/npc pair of the lanes in mask past a branch, jump or
+// any other instruction.  The target is relative to the delay slot.
+static inline void nextPcGroup(unsigned int *pcs, unsigned int *npcs, const unsigned int *mask,
+                               const DecodedInstruction &decoded, const unsigned int *rs, const unsigned int *rt)
+{
+#if LOCKSTEP_AVX2
+    __m256i pc = loadGroup(pcs);
+    __m256i npc = loadGroup(npcs);
+    __m256i m = loadGroup(mask);
+    __m256i target = _mm256_add_epi32(npc, _mm256_set1_epi32(4));
+    if (decoded.control & CTL_BRANCH)
+    {
+        __m256i equal = _mm256_cmpeq_epi32(loadGroup(rs), loadGroup(rt));
+        __m256i branchAddr = _mm256_add_epi32(npc, _mm256_set1_epi32(decoded.immed_se << 2));
+        target = _mm256_blendv_epi8(target, branchAddr, equal);
+    }
+    if (decoded.control & CTL_JUMP)
+        target = _mm256_or_si256(_mm256_and_si256(npc, _mm256_set1_epi32(0xF0000000)),
+                                 _mm256_set1_epi32(decoded.jmpaddr << 2));
+    storeGroup(pcs, _mm256_blendv_epi8(pc, npc, m));
+    storeGroup(npcs, _mm256_blendv_epi8(npc, target, m));
+#else
+    for (unsigned int i = 0; i < LOCKSTEP_GROUP; i++)
+    {
+        if (!mask[i])
+            continue;
+        unsigned int target = npcs[i] + 4;
+        if ((decoded.control & CTL_BRANCH) && (rs[i] == rt[i]))
+            target = (decoded.immed_se << 2) + npcs[i];
+        if (decoded.control & CTL_JUMP)
+            target = (npcs[i] & 0xF0000000) | (decoded.jmpaddr << 2);
+        pcs[i] = npcs[i];
+        npcs[i] = target;
+    }
+#endif
+}
+
+//********************************************
+// Constructor
+Lockstep::Lockstep(const ProgramImage &image, unsigned int lanes)
+    : image(image), imem(image.instructions())
+{
+    laneCount = lanes;
+    stride = (lanes + LOCKSTEP_GROUP - 1) / LOCKSTEP_GROUP * LOCKSTEP_GROUP;
+    regs.assign(32 * stride, 0);
+    pcs.assign(stride, 0);
+    npcs.assign(stride, 4);
+    active.assign(stride, 0);
+    halts.assign(stride, Cpu::HALT_NONE);
+    mask.assign(stride, 0);
+    operand2.assign(stride, 0);
+    result.assign(stride, 0);
+    for (unsigned int i = 0; i < lanes; i++)
+    {
+        active[i] = 0xffffffff;
+        memories.push_back(std::unique_ptr<DataMemory>(new DataMemory()));
+        image.loadData(*memories[i]);
+    }
+    running = lanes;
+    steps = 0;
+    laneInstructions = 0;
+}
+
+//********************************************
+// halt
+// stop the lanes in the mask
+void Lockstep::halt(Cpu::halt_status status)
+{
+    for (unsigned int i = 0; i < laneCount; i++)
+    {
+        if (!mask[i])
+            continue;
+        active[i] = 0;
+        halts[i] = status;
+        running--;
+    }
+}
+
+//********************************************
+// step
+// Execute one instruction for the lanes in the mask.
+// The ALU, register write back and next pc logic
+// work on whole groups of lanes; only the data
+// memory is accessed a lane at a time.
+void Lockstep::step(const DecodedInstruction &decoded)
+{
+    const unsigned int *rsRow = &regs[decoded.rs * stride];
+    const unsigned int *rtRow = &regs[decoded.rt * stride];
+    const unsigned int *operand2Row = rtRow;
+    if (decoded.control & CTL_ALUSRC)
+    {
+        operand2.assign(stride, decoded.immed_se);
+        operand2Row = &operand2[0];
+    }
+    for (unsigned int i = 0; i < stride; i += LOCKSTEP_GROUP)
+        aluGroup(decoded.aluOperation, rsRow + i, operand2Row + i, &result[i]);
+
+    // loads and stores, where result holds the address
+    if (decoded.control & (CTL_MEMWRITE | CTL_MEMTOREG))
+    {
+        for (unsigned int i = 0; i < laneCount; i++)
+        {
+            if (!mask[i])
+                continue;
+            if (decoded.control & CTL_MEMWRITE)
+                memories[i]->update(result[i], rtRow[i], true);
+            if (decoded.control & CTL_MEMTOREG)
+                result[i] = memories[i]->read(result[i], true);
+        }
+    }
+
+    // the next pc depends on the register values read before write back
+    for (unsigned int i = 0; i < stride; i += LOCKSTEP_GROUP)
+        nextPcGroup(&pcs[i], &npcs[i], &mask[i], decoded, rsRow + i, rtRow + i);
+
+    if (decoded.control & CTL_REGWRITE)
+    {
+        unsigned int *destRow = &regs[((decoded.control & CTL_REGDST) ? decoded.rd : decoded.rt) * stride];
+        for (unsigned int i = 0; i < stride; i += LOCKSTEP_GROUP)
+            blendGroup(destRow + i, &result[i], &mask[i]);
+    }
+}
+
+//********************************************
+// run
+unsigned long long Lockstep::run(unsigned long long maxSteps)
+{
+    unsigned long long count = 0;
+    while ((count < maxSteps) && running)
+    {
+        // the lanes furthest behind go first
+        unsigned int leader = 0xffffffff;
+        for (unsigned int i = 0; i < laneCount; i++)
+            if (active[i] && (pcs[i] < leader))
+                leader = pcs[i];
+        unsigned int selected = 0;
+        for (unsigned int i = 0; i < stride; i += LOCKSTEP_GROUP)
+            selected += selectGroup(&mask[i], &active[i], &pcs[i], leader);
+
+        const DecodedInstruction &decoded = imem.decoded(leader);
+        if (decoded.halt)
+        {
+            halt(Cpu::HALT_BREAK);
+            continue;
+        }
+        if ((decoded.control & CTL_JUMP) && ((((leader + 4) & 0xF0000000) | (decoded.jmpaddr << 2)) == leader) &&
+            isIdleInstruction(imem.decoded(leader + 4)))
+        {
+            halt(Cpu::HALT_SELF_LOOP);
+            continue;
+        }
+
+        step(decoded);
+        laneInstructions += selected;
+        count++;
+    }
+    steps += count;
+    return count;
+}
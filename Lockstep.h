@@ -0,0 +1,95 @@
+/*************************************************************************
+ * Lockstep.h
+ *
+ * This file contains the class definition for the lockstep functional
+ * model, which runs one program on many independent machines ("lanes")
+ * at once, typically over different data.  The lanes' register files are
+ * held as structure of arrays, one row of lanes per register, so each
+ * instruction is executed for every lane with vector ALU operations.
+ * Lanes whose branches go different ways are masked: each step runs the
+ * instruction at the lowest pc of any running lane, for just the lanes at
+ * that pc, which brings the lanes back together where their paths meet.
+ *
+ * The vector code is used when the simulator is compiled for AVX2 (for
+ * example with -mavx2 or -march=native); otherwise the same operations
+ * are done a lane at a time.
+ *
+ * This code was developed as a demonstration for SER450 and is provided
+ * as-is as a learning aid for Chapter 4 of the class text.
+ *
+ * COPYRIGHT (C) 2019, Arizona State University
+ * ALL RIGHTS RESERVED
+ *
+ **************************************************************************/
+#ifndef LOCKSTEP_H
+#define LOCKSTEP_H
+#include <memory>
+#include <vector>
+#include "Cpu.h"
+#include "DataMemory.h"
+#include "ProgramImage.h"
+
+// lanes are processed in groups of this many (one AVX2 register)
+#define LOCKSTEP_GROUP 8
+
+class Lockstep
+{
+public:
+    // Each lane starts at pc 0 with zeroed registers and its own data
+    // memory holding the image's initial data.  The image must outlive
+    // the Lockstep.
+    Lockstep(const ProgramImage &image, unsigned int lanes);
+
+    unsigned int lanes() const { return laneCount; }
+
+    // the state of a lane.  Change a lane's memory or registers before
+    // run() to give it different data.
+    DataMemory &memory(unsigned int lane) { return *memories[lane]; }
+    unsigned int reg(unsigned int lane, unsigned int r) const { return regs[r * stride + lane]; }
+    void setReg(unsigned int lane, unsigned int r, unsigned int value) { regs[r * stride + lane] = value; }
+    unsigned int pc(unsigned int lane) const { return pcs[lane]; }
+
+    // A lane halts at a break instruction or a jump to itself whose delay
+    // slot does nothing, as the functional model of Cpu does.
+    Cpu::halt_status status(unsigned int lane) const { return halts[lane]; }
+    bool allHalted() const { return running == 0; }
+
+    // Execute up to maxSteps steps, each one instruction for the lanes at
+    // one pc, stopping early once every lane has halted.  Returns the
+    // number of steps executed.
+    unsigned long long run(unsigned long long maxSteps);
+
+    // totals over every call to run(): the steps executed and the
+    // instructions executed summed over the lanes.  Their ratio is the
+    // average number of lanes doing useful work in each step.
+    unsigned long long getSteps() const { return steps; }
+    unsigned long long getLaneInstructions() const { return laneInstructions; }
+
+private:
+    const ProgramImage &image;
+    const InstructionMemory &imem;
+    unsigned int laneCount;
+    unsigned int stride; // laneCount rounded up to a whole group
+
+    // the per-lane state, each array stride entries long (regs is 32 rows)
+    std::vector<unsigned int> regs;
+    std::vector<unsigned int> pcs;
+    std::vector<unsigned int> npcs;
+    std::vector<unsigned int> active; // all ones for a lane that is running
+    std::vector<Cpu::halt_status> halts;
+    std::vector<std::unique_ptr<DataMemory> > memories;
+    unsigned int running;
+
+    // scratch rows for a step
+    std::vector<unsigned int> mask;
+    std::vector<unsigned int> operand2;
+    std::vector<unsigned int> result;
+
+    unsigned long long steps;
+    unsigned long long laneInstructions;
+
+    void halt(Cpu::halt_status status);
+    void step(const DecodedInstruction &decoded);
+};
+
+#endif // LOCKSTEP_H
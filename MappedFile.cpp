@@ -0,0 +1,163 @@
+/*************************************************************************
+ * MappedFile.cpp
+ *
+ * This file contains the class implementation for a file mapped into the
+ * simulator's address space.
+ *
+ * This code was developed as a demonstration for SER450 and is provided
+ * as-is as a learning aid for Chapter 4 of the class text.
+ *
+ * COPYRIGHT (C) 2019, Arizona State University
+ * ALL RIGHTS RESERVED
+ *
+ **************************************************************************/
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "MappedFile.h"
+
+#if !defined(_WIN32)
+#define MAPPEDFILE_MMAP 1
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#else
+#define MAPPEDFILE_MMAP 0
+#endif
+
+//********************************************
+// Constructor
+MappedFile::MappedFile()
+    : contents(0), length(0), mode(MAP_READ_ONLY), opened(false), mapped(false), path(0)
+{
+}
+
+//********************************************
+// Destructor
+MappedFile::~MappedFile()
+{
+    close();
+}
+
+//********************************************
+// open
+bool MappedFile::open(const char *filename, map_mode mapMode)
+{
+    close();
+    mode = mapMode;
+
+#if MAPPEDFILE_MMAP
+    int fd = ::open(filename, (mode == MAP_WRITE_BACK) ? O_RDWR : O_RDONLY);
+    if (fd < 0)
+        return false;
+    struct stat info;
+    if (fstat(fd, &info) != 0)
+    {
+        ::close(fd);
+        return false;
+    }
+    length = info.st_size;
+    if (length > 0)
+    {
+        int protection = (mode == MAP_READ_ONLY) ? PROT_READ : PROT_READ | PROT_WRITE;
+        int flags = (mode == MAP_WRITE_BACK) ? MAP_SHARED : MAP_PRIVATE;
+        void *memory = mmap(0, length, protection, flags, fd, 0);
+        if (memory == MAP_FAILED)
+        {
+            ::close(fd);
+            length = 0;
+            return false;
+        }
+        contents = (unsigned char *)memory;
+        mapped = true;
+    }
+    ::close(fd); // the mapping keeps its own reference to the file
+#else
+    FILE *file = fopen(filename, "rb");
+    if (!file)
+        return false;
+    fseek(file, 0, SEEK_END);
+    length = ftell(file);
+    fseek(file, 0, SEEK_SET);
+    if (length > 0)
+    {
+        // round up to a whole 4 KB page, as a real mapping would be
+        contents = (unsigned char *)calloc((length + 0xfff) & ~(size_t)0xfff, 1);
+        if ((!contents) || (fread(contents, 1, length, file) != length))
+        {
+            free(contents);
+            contents = 0;
+            length = 0;
+            fclose(file);
+            return false;
+        }
+    }
+    fclose(file);
+#endif
+    if ((mode == MAP_COPY) || (!mapped && (mode == MAP_WRITE_BACK)))
+    {
+        path = (char *)malloc(strlen(filename) + 1);
+        strcpy(path, filename);
+    }
+    opened = true;
+    return true;
+}
+
+//********************************************
+// close
+// unmap the file (saving the contents first for a
+// write-back mapping that isn't a real mapping)
+void MappedFile::close()
+{
+    if (contents)
+    {
+#if MAPPEDFILE_MMAP
+        if (mapped)
+            munmap(contents, length);
+#endif
+        if (!mapped)
+        {
+            if (path && (mode == MAP_WRITE_BACK))
+            {
+                FILE *file = fopen(path, "r+b");
+                if (file)
+                {
+                    fwrite(contents, 1, length, file);
+                    fclose(file);
+                }
+            }
+            free(contents);
+        }
+    }
+    free(path);
+    contents = 0;
+    length = 0;
+    opened = false;
+    mapped = false;
+    path = 0;
+}
+
+//********************************************
+// revert
+// The changes to a copy are private to this process,
+// so the file still holds the original contents.
+bool MappedFile::revert(size_t offset, size_t size)
+{
+    size_t limit = (length + 0xfff) & ~(size_t)0xfff;
+    if ((mode != MAP_COPY) || !path || (offset > limit) || (size > limit - offset))
+        return false;
+    size_t inFile = (offset < length) ? length - offset : 0;
+    if (inFile > size)
+        inFile = size;
+    memset(contents + offset + inFile, 0, size - inFile);
+    if (inFile == 0)
+        return true;
+
+    FILE *file = fopen(path, "rb");
+    if (!file)
+        return false;
+    bool read = (fseek(file, (long)offset, SEEK_SET) == 0) && (fread(contents + offset, 1, inFile, file) == inFile);
+    fclose(file);
+    return read;
+}
@@ -0,0 +1,60 @@
+/*************************************************************************
+ * MappedFile.h
+ *
+ * This file contains the class definition for a file mapped into the
+ * simulator's address space.  On POSIX hosts the file is memory-mapped;
+ * elsewhere its contents are read into (and, for shared mappings, written
+ * back from) an ordinary buffer.
+ *
+ * This code was developed as a demonstration for SER450 and is provided
+ * as-is as a learning aid for Chapter 4 of the class text.
+ *
+ * COPYRIGHT (C) 2019, Arizona State University
+ * ALL RIGHTS RESERVED
+ *
+ **************************************************************************/
+#ifndef MAPPEDFILE_H
+#define MAPPEDFILE_H
+#include <stddef.h>
+
+class MappedFile
+{
+public:
+    typedef enum
+    {
+        MAP_READ_ONLY, // the contents may only be read
+        MAP_COPY,      // the contents may be changed, but changes are not saved
+        MAP_WRITE_BACK // changes to the contents are saved to the file
+    } map_mode;
+
+    MappedFile();
+    ~MappedFile();
+
+    // map a file, returning false if it can't be opened or mapped
+    bool open(const char *filename, map_mode mode = MAP_READ_ONLY);
+    void close();
+
+    // discard the changes to part of a MAP_COPY mapping, reading it back
+    // from the file.  Returns false for any other kind of mapping.
+    bool revert(size_t offset, size_t size);
+
+    // the contents run to the next 4 KB boundary past size(), with the
+    // bytes after the end of the file reading as zero
+    unsigned char *data() const { return contents; }
+    size_t size() const { return length; }
+    bool isOpen() const { return opened; }
+
+private:
+    unsigned char *contents;
+    size_t length;
+    map_mode mode;
+    bool opened;
+    bool mapped; // false if contents is a heap buffer
+    char *path;  // for writing back a heap buffer or reverting a copy
+
+    // not copyable
+    MappedFile(const MappedFile &);
+    MappedFile &operator=(const MappedFile &);
+};
+
+#endif // MAPPEDFILE_H
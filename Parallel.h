@@ -0,0 +1,103 @@
+/*************************************************************************
+ * Parallel.h
+ *
+ * This file contains a helper that shares independent pieces of work out
+ * to a pool of host threads.  Idle threads take the next piece from a
+ * shared counter, so a thread that finishes early keeps taking work
+ * until none is left, however uneven the pieces are.  When the pieces
+ * are only produced as the work goes on, a bounded queue passes them
+ * from the producing thread to the pool instead.
+ *
+ * This code was developed as a demonstration for SER450 and is provided
+ * as-is as a learning aid for Chapter 4 of the class text.
+ *
+ * COPYRIGHT (C) 2019, Arizona State University
+ * ALL RIGHTS RESERVED
+ *
+ **************************************************************************/
+#ifndef PARALLEL_H
+#define PARALLEL_H
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// the number of threads to use when 0 is requested: one per host core
+inline unsigned int defaultThreads()
+{
+    unsigned int cores = std::thread::hardware_concurrency();
+    return cores ? cores : 1;
+}
+
+// Call work(i) for every i from 0 to count-1, on up to threads threads
+// (0 for one per core).  Returns once every call has completed.
+template <typename Work>
+void parallelFor(unsigned int count, unsigned int threads, Work work)
+{
+    if (threads == 0)
+        threads = defaultThreads();
+    if (threads > count)
+        threads = count;
+    std::atomic<unsigned int> next(0);
+    std::vector<std::thread> pool;
+    for (unsigned int i = 0; i < threads; i++)
+        pool.push_back(std::thread([&]() {
+            unsigned int index;
+            while ((index = next++) < count)
+                work(index);
+        }));
+    for (unsigned int i = 0; i < pool.size(); i++)
+        pool[i].join();
+}
+
+// A queue holding at most capacity items, between a thread that produces
+// them and threads that consume them.  push() waits while the queue is
+// full, so the producer never gets more than capacity items ahead.  pop()
+// waits while the queue is empty, and returns false once it is empty and
+// close() has been called.
+template <typename T>
+class BoundedQueue
+{
+public:
+    BoundedQueue(unsigned int capacity) : capacity(capacity ? capacity : 1), closed(false) {}
+
+    void push(T &&item)
+    {
+        std::unique_lock<std::mutex> lock(mutex);
+        notFull.wait(lock, [&]() { return items.size() < capacity; });
+        items.push_back(std::move(item));
+        notEmpty.notify_one();
+    }
+
+    bool pop(T &item)
+    {
+        std::unique_lock<std::mutex> lock(mutex);
+        notEmpty.wait(lock, [&]() { return !items.empty() || closed; });
+        if (items.empty())
+            return false;
+        item = std::move(items.front());
+        items.pop_front();
+        notFull.notify_one();
+        return true;
+    }
+
+    // no more items will be pushed
+    void close()
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        closed = true;
+        notEmpty.notify_all();
+    }
+
+private:
+    std::deque<T> items;
+    unsigned int capacity;
+    bool closed;
+    std::mutex mutex;
+    std::condition_variable notEmpty;
+    std::condition_variable notFull;
+};
+
+#endif // PARALLEL_H
@@ -0,0 +1,174 @@
+/*************************************************************************
+ * Profiler.cpp
+ *
+ * This file contains the class implementation for the hot-spot profiler.
+ *
+ * This code was developed as a demonstration for SER450 and is provided
+ * as-is as a learning aid for Chapter 4 of the class text.
+ *
+ * COPYRIGHT (C) 2019, Arizona State University
+ * ALL RIGHTS RESERVED
+ *
+ **************************************************************************/
+#include <stdio.h>
+#include <string.h>
+#include <algorithm>
+#include <map>
+#include <vector>
+#include "Decoder.h"
+#include "Profiler.h"
+
+// the events received by the instruction in EX; the rest are in ID
+#define EX_EVENTS (TRACE_EVENT_MEM_TO_ALU_A | TRACE_EVENT_MEM_TO_ALU_B | TRACE_EVENT_WB_TO_ALU_A | TRACE_EVENT_WB_TO_ALU_B)
+#define FORWARDING_EVENTS (EX_EVENTS | TRACE_EVENT_MEM_TO_EQUALITY_RS | TRACE_EVENT_MEM_TO_EQUALITY_RT)
+
+static inline unsigned long long runKey(unsigned int start, unsigned int pc)
+{
+    return ((unsigned long long)start << 32) | pc;
+}
+
+static inline unsigned int eventIndex(unsigned int event)
+{
+    unsigned int index = 0;
+    while (!(event & (1u << index)))
+        index++;
+    return index;
+}
+
+//********************************************
+// Constructor
+Profiler::Profiler()
+    : cycles(0), bubbleCycles(0), inRun(false), runStart(0), lastPc(0)
+{
+    memset(recent, 0, sizeof(recent));
+    memset(recentPc, 0, sizeof(recentPc));
+}
+
+//********************************************
+// profile
+// find (or start) the histogram for a pc
+Profiler::pc_profile &Profiler::profile(unsigned int pc, unsigned int instruction)
+{
+    unsigned int slot = (pc >> 2) & 255;
+    if (recent[slot] && (recentPc[slot] == pc))
+        return *recent[slot];
+    pc_profile &found = profiles[pc];
+    found.instruction = instruction;
+    recent[slot] = &found;
+    recentPc[slot] = pc;
+    return found;
+}
+
+//********************************************
+// record
+// charge one clock cycle
+void Profiler::record(const cycle_sample &sample)
+{
+    cycles++;
+    for (unsigned int stage = 0; stage < 5; stage++)
+        if (sample.valid & (1u << stage))
+            profile(sample.pc[stage], sample.instruction[stage]).stageCycles[stage]++;
+
+    for (unsigned int events = sample.events; events; events &= events - 1)
+    {
+        unsigned int event = events & (0u - events);
+        unsigned int stage = (event & EX_EVENTS) ? TRACE_STAGE_EXE : TRACE_STAGE_ID;
+        if (sample.valid & (1u << stage))
+            profile(sample.pc[stage], sample.instruction[stage]).events[eventIndex(event)]++;
+    }
+
+    if (!(sample.valid & (1u << TRACE_STAGE_ID)))
+    {
+        bubbleCycles++;
+        return;
+    }
+    // a stalled instruction stays in the same run
+    unsigned int pc = sample.pc[TRACE_STAGE_ID];
+    if (!inRun || ((pc != lastPc) && (pc != lastPc + 4)))
+        runStart = pc;
+    inRun = true;
+    lastPc = pc;
+    runCycles[runKey(runStart, pc)]++;
+}
+
+//********************************************
+// writeReport
+void Profiler::writeReport(std::ostream &out) const
+{
+    char line[200];
+    char text[64];
+    std::vector<std::pair<unsigned int, const pc_profile *>> sorted;
+    for (auto &entry : profiles)
+        sorted.push_back(std::make_pair(entry.first, &entry.second));
+    std::sort(sorted.begin(), sorted.end(), [](const std::pair<unsigned int, const pc_profile *> &a,
+                                               const std::pair<unsigned int, const pc_profile *> &b) {
+        if (a.second->stageCycles[TRACE_STAGE_ID] != b.second->stageCycles[TRACE_STAGE_ID])
+            return a.second->stageCycles[TRACE_STAGE_ID] > b.second->stageCycles[TRACE_STAGE_ID];
+        return a.first < b.first;
+    });
+    double total = cycles ? (double)cycles : 1.0;
+
+    snprintf(line, sizeof(line), "Profile of %llu clock cycles (%llu with a bubble in ID)\n\n", cycles, bubbleCycles);
+    out << line;
+    snprintf(line, sizeof(line), "%-8s  %-28s %12s %7s %10s %10s %10s %12s\n", "pc", "instruction", "cycles", "%",
+             "load-use", "branch", "forwards", "retired");
+    out << line;
+    for (unsigned int i = 0; i < sorted.size(); i++)
+    {
+        const pc_profile &p = *sorted[i].second;
+        unsigned long long forwards = 0;
+        for (unsigned int event = 0; event < TRACE_EVENT_COUNT; event++)
+            if (FORWARDING_EVENTS & (1u << event))
+                forwards += p.events[event];
+        snprintf(line, sizeof(line), "%08x  %-28s %12llu %6.2f%% %10llu %10llu %10llu %12llu\n", sorted[i].first,
+                 disassemble(p.instruction, text, sizeof(text)), p.stageCycles[TRACE_STAGE_ID],
+                 100.0 * p.stageCycles[TRACE_STAGE_ID] / total, p.events[eventIndex(TRACE_EVENT_LOAD_USE_STALL)],
+                 p.events[eventIndex(TRACE_EVENT_BRANCH_STALL)], forwards, p.stageCycles[TRACE_STAGE_WB]);
+        out << line;
+    }
+
+    // the runs of code, most cycles first
+    std::map<unsigned int, std::pair<unsigned long long, unsigned int>> runs; // start -> cycles, instructions
+    for (auto &entry : runCycles)
+    {
+        std::pair<unsigned long long, unsigned int> &run = runs[(unsigned int)(entry.first >> 32)];
+        run.first += entry.second;
+        run.second++;
+    }
+    std::vector<std::pair<unsigned int, std::pair<unsigned long long, unsigned int>>> sortedRuns(runs.begin(), runs.end());
+    std::stable_sort(sortedRuns.begin(), sortedRuns.end(),
+                     [](const std::pair<unsigned int, std::pair<unsigned long long, unsigned int>> &a,
+                        const std::pair<unsigned int, std::pair<unsigned long long, unsigned int>> &b) {
+                         return a.second.first > b.second.first;
+                     });
+    snprintf(line, sizeof(line), "\nRuns of code, by the pc they start at\n\n%-8s  %12s %7s %12s\n", "start",
+             "cycles", "%", "instructions");
+    out << line;
+    for (unsigned int i = 0; i < sortedRuns.size(); i++)
+    {
+        snprintf(line, sizeof(line), "%08x  %12llu %6.2f%% %12u\n", sortedRuns[i].first, sortedRuns[i].second.first,
+                 100.0 * sortedRuns[i].second.first / total, sortedRuns[i].second.second);
+        out << line;
+    }
+}
+
+//********************************************
+// writeFolded
+// one line per (run, instruction), sorted so that
+// the output is the same from one run to the next
+void Profiler::writeFolded(std::ostream &out, const char *root) const
+{
+    char line[200];
+    char text[64];
+    std::map<unsigned long long, unsigned long long> sorted(runCycles.begin(), runCycles.end());
+    for (auto &entry : sorted)
+    {
+        unsigned int start = (unsigned int)(entry.first >> 32);
+        unsigned int pc = (unsigned int)entry.first;
+        snprintf(line, sizeof(line), "%s;run_%08x;%08x %s %llu\n", root, start, pc,
+                 disassemble(profiles.at(pc).instruction, text, sizeof(text)), entry.second);
+        out << line;
+    }
+    if (bubbleCycles)
+        out << root << ";(bubble) " << bubbleCycles << "\n";
+}
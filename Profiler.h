@@ -0,0 +1,90 @@
+/*************************************************************************
+ * Profiler.h
+ *
+ * This file contains the class definition for the hot-spot profiler.
+ * The Cpu reports which instruction is in each pipeline stage every clock
+ * cycle, along with the forwarding and stall events of the cycle, and
+ * the profiler keeps a histogram of them for each pc.
+ *
+ * Every cycle is charged to the instruction in ID, where the hazard
+ * detection unit holds stalled instructions, so an instruction's cycles
+ * are one plus the cycles it stalled, and the cycles of all the
+ * instructions (plus those with a bubble in ID) add up to the run time.
+ * Forwarding events are charged to the instruction that receives the
+ * value: the one in EX for the ALU, the beq in ID for the equality unit.
+ *
+ * Cycles are also grouped by the straight-line run of code that the
+ * instruction was reached through (a new run starts wherever the pc in ID
+ * doesn't follow on from the one before), which picks out loop bodies.
+ * These groups are written as folded stacks ("frame;frame count" lines),
+ * the input format of flamegraph tools.
+ *
+ * This code was developed as a demonstration for SER450 and is provided
+ * as-is as a learning aid for Chapter 4 of the class text.
+ *
+ * COPYRIGHT (C) 2019, Arizona State University
+ * ALL RIGHTS RESERVED
+ *
+ **************************************************************************/
+#ifndef PROFILER_H
+#define PROFILER_H
+#include <ostream>
+#include <unordered_map>
+#include "BinaryTrace.h"
+
+class Profiler
+{
+public:
+    // what the pipeline held during one clock cycle
+    typedef struct
+    {
+        unsigned int pc[5];          // the instruction's address, in TRACE_STAGE_xxx order
+        unsigned int instruction[5];
+        unsigned int valid;          // a bit for each stage holding an instruction rather than a bubble
+        unsigned int events;         // TRACE_EVENT_xxx bits
+    } cycle_sample;
+
+    // the histogram for one pc
+    typedef struct
+    {
+        unsigned int instruction;
+        unsigned long long stageCycles[5];            // cycles spent in each stage
+        unsigned long long events[TRACE_EVENT_COUNT]; // indexed by event bit number
+    } pc_profile;
+
+    Profiler();
+    void record(const cycle_sample &sample);
+
+    unsigned long long getCycles() const { return cycles; }
+    const std::unordered_map<unsigned int, pc_profile> &getProfiles() const { return profiles; }
+
+    // a table of the pcs, most cycles first, followed by the runs of
+    // code they were reached through
+    void writeReport(std::ostream &out) const;
+
+    // folded stacks of root;run;instruction
+    void writeFolded(std::ostream &out, const char *root) const;
+
+private:
+    unsigned long long cycles;
+    unsigned long long bubbleCycles; // cycles with a bubble in ID
+    std::unordered_map<unsigned int, pc_profile> profiles;
+    std::unordered_map<unsigned long long, unsigned long long> runCycles; // (run start, pc) -> cycles
+
+    // the current run of code through ID
+    bool inRun;
+    unsigned int runStart;
+    unsigned int lastPc;
+
+    // recently used profiles, to avoid a hash lookup for each stage
+    pc_profile *recent[256];
+    unsigned int recentPc[256];
+
+    pc_profile &profile(unsigned int pc, unsigned int instruction);
+
+    // not copyable (recent points into profiles)
+    Profiler(const Profiler &);
+    Profiler &operator=(const Profiler &);
+};
+
+#endif // PROFILER_H
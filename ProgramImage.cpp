@@ -0,0 +1,378 @@
+/*************************************************************************
+ * ProgramImage.cpp
+ *
+ * This file contains the class implementation for a program image.
+ *
+ * This code was developed as a demonstration for SER450 and is provided
+ * as-is as a learning aid for Chapter 4 of the class text.
+ *
+ * COPYRIGHT (C) 2019, Arizona State University
+ * ALL RIGHTS RESERVED
+ *
+ **************************************************************************/
+#include <stdio.h>
+#include <string.h>
+#include <map>
+#include "ProgramImage.h"
+
+// Binary image layout.  All fields are in host byte order; an image made on
+// a host of the other byte order fails the magic number check.
+//
+//   image_header
+//   image_section[sectionCount]
+//   section contents, each starting on a 16 byte boundary (the data
+//   pages on a 4 KB boundary, so that they can be mapped)
+//
+// The data pages are the data words stored in a little-endian memory.
+// The checksum is the FNV-1a hash of every byte that follows the header.
+#define IMAGE_MAGIC 0x474d4953 // "SIMG" on a little-endian host
+#define IMAGE_VERSION 2
+
+// changes whenever DecodedInstruction or decodeInstruction changes, so that
+// stale predecoded sections are decoded again instead of being trusted
+#define IMAGE_DECODER_VERSION 1
+
+#define SECTION_TEXT 1    // instruction words starting at address 0
+#define SECTION_DATA 2    // (address, value) pairs for the initial data
+#define SECTION_DECODED 3 // a DecodedInstruction for each word of text
+#define SECTION_PAGE_NUMBERS 4 // the page number of each data page, ascending
+#define SECTION_DATA_PAGES 5   // the memory pages holding the initial data
+
+typedef struct
+{
+    unsigned int magic;
+    unsigned int version;
+    unsigned int decoderVersion;
+    unsigned int sectionCount;
+    unsigned int checksum;
+    unsigned int reserved[3];
+} image_header;
+
+typedef struct
+{
+    unsigned int type;
+    unsigned int count;  // the number of words, pairs or records
+    unsigned int offset; // from the start of the file
+    unsigned int length; // in bytes
+} image_section;
+
+static_assert(sizeof(image_header) == 32, "image header layout");
+static_assert(sizeof(image_section) == 16, "image section layout");
+static_assert(sizeof(DecodedInstruction) == 16, "predecoded section layout");
+
+static unsigned int fnv1a(const unsigned char *p, size_t length, unsigned int hash = 0x811c9dc5)
+{
+    for (size_t i = 0; i < length; i++)
+        hash = (hash ^ p[i]) * 0x01000193;
+    return hash;
+}
+
+// the value of a hex digit, or -1 if c is not a hex digit
+static inline int hexDigit(unsigned char c)
+{
+    if ((c >= '0') && (c <= '9'))
+        return c - '0';
+    c |= 0x20; // lower case
+    if ((c >= 'a') && (c <= 'f'))
+        return c - 'a' + 10;
+    return -1;
+}
+
+//********************************************
+// Constructor
+ProgramImage::ProgramImage()
+    : imageData(0), imageDataCount(0), imagePageNumbers(0), imagePageCount(0), imagePageStart(0)
+{
+}
+
+//********************************************
+// loadText
+// The file is mapped into memory and scanned in
+// place.
+bool ProgramImage::loadText(const char *filename)
+{
+    MappedFile textFile;
+    if (!textFile.open(filename))
+        return false;
+    parseText(textFile.data(), textFile.data() + textFile.size());
+    return true;
+}
+
+//********************************************
+// parseText
+// scan the lines of a text program
+void ProgramImage::parseText(const unsigned char *p, const unsigned char *end)
+{
+    while (p < end)
+    {
+        // scan up to three whitespace separated hex fields
+        unsigned int fields[3];
+        int count = 0;
+        while (count < 3)
+        {
+            while ((p < end) && ((*p == ' ') || (*p == '\t') || (*p == '\r')))
+                p++;
+            if ((end - p > 2) && (p[0] == '0') && ((p[1] | 0x20) == 'x') && (hexDigit(p[2]) >= 0))
+                p += 2;
+            unsigned int value = 0;
+            int digits = 0;
+            int digit;
+            while ((p < end) && ((digit = hexDigit(*p)) >= 0))
+            {
+                value = (value << 4) | digit;
+                p++;
+                digits++;
+            }
+            if (digits == 0)
+                break;
+            fields[count++] = value;
+        }
+
+        if (count == 3)
+        {
+            if (fields[1] == 1)
+                setInstruction(fields[0], fields[2]);
+            else if (fields[1] == 0)
+                setData(fields[0], fields[2]);
+        }
+
+        // skip the rest of the line
+        p = (const unsigned char *)memchr(p, '\n', end - p);
+        if (!p)
+            break;
+        p++;
+    }
+}
+
+//********************************************
+// loadBinary
+// Every section is checked to lie within the file
+// before anything refers to it, but the contents are
+// only read (and the checksum computed) if asked, so
+// that loading doesn't touch every page of the file.
+bool ProgramImage::loadBinary(const char *filename, bool verify)
+{
+    if (!file.open(filename))
+        return false;
+    const unsigned char *base = file.data();
+    size_t size = file.size();
+
+    const image_header *header = (const image_header *)base;
+    if ((size < sizeof(image_header)) || (header->magic != IMAGE_MAGIC) ||
+        (header->version != IMAGE_VERSION) ||
+        (header->sectionCount > (size - sizeof(image_header)) / sizeof(image_section)) ||
+        (verify && (fnv1a(base + sizeof(image_header), size - sizeof(image_header)) != header->checksum)))
+    {
+        file.close();
+        return false;
+    }
+
+    const image_section *sections = (const image_section *)(base + sizeof(image_header));
+    const unsigned int *words = 0;
+    const DecodedInstruction *decoded = 0;
+    const data_word *dataWords = 0;
+    const unsigned int *pageNumbers = 0;
+    const unsigned char *pages = 0;
+    unsigned int wordCount = 0;
+    unsigned int decodedCount = 0;
+    unsigned int dataCount = 0;
+    unsigned int pageNumberCount = 0;
+    unsigned int pageCount = 0;
+    for (unsigned int i = 0; i < header->sectionCount; i++)
+    {
+        const image_section &section = sections[i];
+        if ((section.offset > size) || (section.length > size - section.offset) || (section.offset & 0xf))
+        {
+            file.close();
+            return false;
+        }
+        const unsigned char *contents = base + section.offset;
+        if ((section.type == SECTION_TEXT) && (section.count <= section.length / sizeof(unsigned int)))
+        {
+            words = (const unsigned int *)contents;
+            wordCount = section.count;
+        }
+        else if ((section.type == SECTION_DATA) && (section.count <= section.length / sizeof(data_word)))
+        {
+            dataWords = (const data_word *)contents;
+            dataCount = section.count;
+        }
+        else if ((section.type == SECTION_DECODED) && (section.count <= section.length / sizeof(DecodedInstruction)))
+        {
+            decoded = (const DecodedInstruction *)contents;
+            decodedCount = section.count;
+        }
+        else if ((section.type == SECTION_PAGE_NUMBERS) && (section.count <= section.length / sizeof(unsigned int)))
+        {
+            pageNumbers = (const unsigned int *)contents;
+            pageNumberCount = section.count;
+        }
+        else if ((section.type == SECTION_DATA_PAGES) && (section.count <= section.length / DMEM_PAGE_SIZE) &&
+                 !(section.offset & (DMEM_PAGE_SIZE - 1)))
+        {
+            pages = contents;
+            pageCount = section.count;
+        }
+    }
+
+    // the sections are only kept once every one of them has been checked,
+    // so a rejected image leaves nothing pointing into the closed file.
+    // Predecoded records are only used if they match both the text and this decoder
+    if ((decodedCount != wordCount) || (header->decoderVersion != IMAGE_DECODER_VERSION))
+        decoded = 0;
+    text.attach(words, decoded, wordCount);
+    imageData = dataWords;
+    imageDataCount = dataCount;
+
+    // the data pages are only mapped if there is a page number for each,
+    // otherwise the data words are copied
+    if (pages && (pageNumberCount == pageCount))
+    {
+        imagePageNumbers = pageNumbers;
+        imagePageCount = pageCount;
+        imagePageStart = (pages - base) / DMEM_PAGE_SIZE;
+    }
+    this->filename = filename;
+    return true;
+}
+
+//********************************************
+// load
+// a file that starts with the image magic number is
+// a binary image, anything else is text
+bool ProgramImage::load(const char *filename, bool verify)
+{
+    MappedFile probe;
+    if (!probe.open(filename))
+        return false;
+    if ((probe.size() >= sizeof(image_header)) &&
+        (((const image_header *)probe.data())->magic == IMAGE_MAGIC))
+    {
+        probe.close();
+        return loadBinary(filename, verify);
+    }
+    parseText(probe.data(), probe.data() + probe.size());
+    return true;
+}
+
+//********************************************
+// saveBinary
+bool ProgramImage::saveBinary(const char *filename, bool predecoded) const
+{
+    // trailing nop words are not stored, they read as nop anyway
+    unsigned int wordCount = text.size();
+    while ((wordCount > 0) && (text.value((wordCount - 1) << 2) == 0))
+        wordCount--;
+
+    // gather the sections
+    std::vector<unsigned int> words(wordCount);
+    std::vector<DecodedInstruction> decoded;
+    for (unsigned int i = 0; i < wordCount; i++)
+        words[i] = text.value(i << 2);
+    if (predecoded)
+    {
+        decoded.resize(wordCount);
+        for (unsigned int i = 0; i < wordCount; i++)
+            decoded[i] = text.decoded(i << 2);
+    }
+    std::vector<data_word> allData(imageData, imageData + imageDataCount);
+    allData.insert(allData.end(), data.begin(), data.end());
+
+    // the data words laid out as the pages of a little-endian memory
+    std::map<unsigned int, std::vector<unsigned char> > pageMap;
+    for (unsigned int i = 0; i < allData.size(); i++)
+    {
+        std::vector<unsigned char> &page = pageMap[allData[i].addr >> DMEM_PAGE_BITS];
+        if (page.empty())
+            page.resize(DMEM_PAGE_SIZE);
+        for (unsigned int j = 0; j < 4; j++)
+        {
+            unsigned int addr = allData[i].addr + j;
+            if ((addr >> DMEM_PAGE_BITS) != (allData[i].addr >> DMEM_PAGE_BITS))
+            {
+                // an unaligned word that crosses into the next page
+                std::vector<unsigned char> &next = pageMap[addr >> DMEM_PAGE_BITS];
+                if (next.empty())
+                    next.resize(DMEM_PAGE_SIZE);
+                next[addr & (DMEM_PAGE_SIZE - 1)] = allData[i].value >> (8 * j);
+            }
+            else
+                page[addr & (DMEM_PAGE_SIZE - 1)] = allData[i].value >> (8 * j);
+        }
+    }
+    std::vector<unsigned int> pageNumbers;
+    std::vector<unsigned char> pages;
+    for (auto &entry : pageMap)
+    {
+        pageNumbers.push_back(entry.first);
+        pages.insert(pages.end(), entry.second.begin(), entry.second.end());
+    }
+
+    // the pages go last, as they are aligned to a page boundary
+    const void *contents[5] = {words.data(), allData.data(), pageNumbers.data(), decoded.data(), pages.data()};
+    image_section sections[5] = {
+        {SECTION_TEXT, wordCount, 0, (unsigned int)(words.size() * sizeof(unsigned int))},
+        {SECTION_DATA, (unsigned int)allData.size(), 0, (unsigned int)(allData.size() * sizeof(data_word))},
+        {SECTION_PAGE_NUMBERS, (unsigned int)pageNumbers.size(), 0,
+         (unsigned int)(pageNumbers.size() * sizeof(unsigned int))},
+        {SECTION_DECODED, wordCount, 0, (unsigned int)(decoded.size() * sizeof(DecodedInstruction))},
+        {SECTION_DATA_PAGES, (unsigned int)pageNumbers.size(), 0, (unsigned int)pages.size()}};
+    if (!predecoded)
+    {
+        sections[3] = sections[4];
+        contents[3] = contents[4];
+    }
+    unsigned int sectionCount = predecoded ? 5 : 4;
+
+    // lay out the file and build it in memory
+    unsigned int offset = sizeof(image_header) + sectionCount * sizeof(image_section);
+    for (unsigned int i = 0; i < sectionCount; i++)
+    {
+        unsigned int alignment = (sections[i].type == SECTION_DATA_PAGES) ? DMEM_PAGE_SIZE - 1 : 0xf;
+        offset = (offset + alignment) & ~alignment;
+        sections[i].offset = offset;
+        offset += sections[i].length;
+    }
+    std::vector<unsigned char> image(offset, 0);
+    memcpy(image.data() + sizeof(image_header), sections, sectionCount * sizeof(image_section));
+    for (unsigned int i = 0; i < sectionCount; i++)
+        if (sections[i].length)
+            memcpy(image.data() + sections[i].offset, contents[i], sections[i].length);
+
+    image_header header = {IMAGE_MAGIC, IMAGE_VERSION, IMAGE_DECODER_VERSION, sectionCount, 0, {0, 0, 0}};
+    header.checksum = fnv1a(image.data() + sizeof(image_header), image.size() - sizeof(image_header));
+    memcpy(image.data(), &header, sizeof(image_header));
+
+    FILE *out = fopen(filename, "wb");
+    if (!out)
+        return false;
+    bool written = fwrite(image.data(), 1, image.size(), out) == image.size();
+    return (fclose(out) == 0) && written;
+}
+
+void ProgramImage::setInstruction(unsigned int addr, unsigned int value)
+{
+    text.setAt(addr, value);
+}
+
+void ProgramImage::setData(unsigned int addr, unsigned int value)
+{
+    data_word word = {addr, value};
+    data.push_back(word);
+}
+
+void ProgramImage::loadData(DataMemory &dmem) const
+// data words are written in the order they were given, so a later
+// word for the same address replaces an earlier one
+{
+    // a binary image's pages can stand in for its data words unless they
+    // would replace something already in the memory
+    bool mapPages = (imagePageCount > 0) && !dmem.isBigEndian();
+    for (unsigned int i = 0; mapPages && (i < imagePageCount); i++)
+        mapPages = (dmem.pageData(imagePageNumbers[i]) == 0);
+    if (!mapPages || !dmem.mapFilePages(filename.c_str(), imagePageStart, imagePageNumbers, imagePageCount))
+        for (unsigned int i = 0; i < imageDataCount; i++)
+            dmem.update(imageData[i].addr, imageData[i].value, true);
+    for (unsigned int i = 0; i < data.size(); i++)
+        dmem.update(data[i].addr, data[i].value, true);
+}
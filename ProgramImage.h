@@ -0,0 +1,91 @@
+/*************************************************************************
+ * ProgramImage.h
+ *
+ * This file contains the class definition for a program image: the
+ * contents of instruction memory and the initial contents of data memory
+ * for a program.  An image is built once and then shared, read-only, by
+ * every Cpu that runs the program.
+ *
+ * This code was developed as a demonstration for SER450 and is provided
+ * as-is as a learning aid for Chapter 4 of the class text.
+ *
+ * COPYRIGHT (C) 2019, Arizona State University
+ * ALL RIGHTS RESERVED
+ *
+ **************************************************************************/
+#ifndef PROGRAMIMAGE_H
+#define PROGRAMIMAGE_H
+#include <string>
+#include <vector>
+#include "DataMemory.h"
+#include "InstructionMemory.h"
+#include "MappedFile.h"
+
+class ProgramImage
+{
+public:
+    ProgramImage();
+
+    // Load a program from a text file.  Each line holds three hex fields,
+    // "address type value", where type 1 places value in instruction memory
+    // and type 0 places it in the initial data.  Anything after the third
+    // field, and any line starting with '#', is a comment.  Returns false
+    // if the file can't be read.
+    bool loadText(const char *filename);
+
+    // Load a program from a binary image written by saveBinary.  The file
+    // is mapped and instruction memory refers to it directly, and its data
+    // pages are mapped into each data memory the program runs in, so the
+    // image must not change while it is loaded, and an image can only be
+    // loaded from a binary file once.  The checksum, which covers the whole
+    // file, is only checked if verify is true.  Returns false if the file
+    // can't be read or isn't a valid image.
+    bool loadBinary(const char *filename, bool verify = false);
+
+    // load either a binary image or a text file, depending on the contents
+    bool load(const char *filename, bool verify = false);
+
+    // Write the program as a binary image.  If predecoded is true the image
+    // also holds the decoded form of every instruction so that loading it
+    // does no decoding at all.
+    bool saveBinary(const char *filename, bool predecoded = true) const;
+
+    // place an instruction in the text of the program
+    void setInstruction(unsigned int addr, unsigned int value);
+
+    // place a word in the initial contents of data memory
+    void setData(unsigned int addr, unsigned int value);
+
+    // the instruction memory for the program
+    const InstructionMemory &instructions() const { return text; }
+
+    // Place the initial data in a data memory.  The pages of a binary image
+    // are mapped copy-on-write when the memory is little-endian and holds
+    // nothing on those pages yet; otherwise the data words are copied.
+    void loadData(DataMemory &dmem) const;
+
+private:
+    typedef struct
+    {
+        unsigned int addr;
+        unsigned int value;
+    } data_word;
+
+    InstructionMemory text;
+    std::vector<data_word> data;
+
+    // a loaded binary image and the data words within it, which come
+    // before the words in data, along with the same words laid out as
+    // whole pages of memory
+    MappedFile file;
+    std::string filename;
+    const data_word *imageData;
+    unsigned int imageDataCount;
+    const unsigned int *imagePageNumbers;
+    unsigned int imagePageCount;
+    unsigned int imagePageStart; // the file page holding the first data page
+
+    void parseText(const unsigned char *p, const unsigned char *end);
+};
+
+#endif // PROGRAMIMAGE_H
@@ -15,6 +15,7 @@
 *
 **************************************************************************/#include <stdio.h>
 #include "RegisterFile.h"
+#include "TraceSink.h"
 
 RegisterFile::RegisterFile()
 {
@@ -48,3 +49,19 @@ void RegisterFile::dump(void)
         printf("R%02x: %08x R%02x: %08x\n",i+16,regs[i+16],i+24,regs[i+24]);
     }
 }
+
+void RegisterFile::dump(TraceSink &sink)
+{
+    dump(regs, sink);
+}
+
+void RegisterFile::dump(const unsigned int *values, TraceSink &sink)
+{
+    for (unsigned int i=0;i<8;i++) {
+        for (unsigned int j=0;j<4;j++) {
+            sink << "R";
+            sink.hex(i+8*j,2) << ": ";
+            sink.hex(values[i+8*j]) << ((j<3) ? " " : "\n");
+        }
+    }
+}
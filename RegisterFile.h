@@ -17,6 +17,8 @@
 #ifndef REGISTERFILE_H
 #define REGISTERFILE_H
 
+class TraceSink;
+
 class RegisterFile
 {
     public:
@@ -26,6 +28,9 @@ class RegisterFile
         unsigned int readData2(unsigned int addr);
 
         void dump(); // dump the contents of the register file to the standard output for debugging
+        void dump(TraceSink &sink); // or to a trace sink
+        static void dump(const unsigned int *values, TraceSink &sink); // the same format for any 32 register values
+        unsigned int *data() { return regs; } // direct access to the registers for translated code
     private:
         unsigned int regs[32];
 };
@@ -0,0 +1,146 @@
+/*************************************************************************
+ * Sampler.cpp
+ *
+ * This file contains the class implementation for the sampling driver.
+ *
+ * This code was developed as a demonstration for SER450 and is provided
+ * as-is as a learning aid for Chapter 4 of the class text.
+ *
+ * COPYRIGHT (C) 2019, Arizona State University
+ * ALL RIGHTS RESERVED
+ *
+ **************************************************************************/
+#include <math.h>
+#include <algorithm>
+#include <thread>
+#include "Sampler.h"
+#include "Parallel.h"
+#include "RegisterFile.h"
+
+//********************************************
+// Constructor
+Sampler::Sampler(const ProgramImage &image)
+    : image(image)
+{
+    interval = 1000000;
+    warmupCycles = 100;
+    windowCycles = 10000;
+    threads = 0;
+    jitEnabled = true;
+    setup = 0;
+    setupContext = 0;
+}
+
+void Sampler::setWindow(unsigned long long warmupCycles, unsigned long long windowCycles)
+{
+    this->warmupCycles = warmupCycles;
+    this->windowCycles = windowCycles;
+}
+
+void Sampler::setMemorySetup(memory_setup setup, void *context)
+{
+    this->setup = setup;
+    setupContext = context;
+}
+
+//********************************************
+// measure
+// Each window gets its own data memory, register
+// file and Cpu, all sharing the program image, so
+// windows can be simulated on any thread.
+Sampler::sample Sampler::measure(const std::vector<unsigned char> &checkpoint) const
+{
+    DataMemory dmem;
+    RegisterFile regs;
+    if (setup)
+        setup(dmem, setupContext);
+    Cpu cpu(image, dmem, regs);
+    sample measured = {0, 0, 0};
+    if (!cpu.loadCheckpoint(checkpoint.data(), checkpoint.size()))
+        return measured;
+    measured.instruction = cpu.getFunctionalInstructions();
+
+    cpu.run(warmupCycles);
+    unsigned long long startCycle = cpu.getClockCycle();
+    unsigned long long startRetired = cpu.getEvents().retired;
+    cpu.run(windowCycles);
+    measured.cycles = cpu.getClockCycle() - startCycle;
+    measured.retired = cpu.getEvents().retired - startRetired;
+    return measured;
+}
+
+//********************************************
+// run
+// The functional model runs on the calling thread and
+// passes each checkpoint to the worker threads as soon
+// as it is taken.  The queue between them is bounded,
+// so only a few checkpoints are held at once, and each
+// is freed once its window has been simulated.
+Sampler::result Sampler::run(unsigned long long maxInstructions)
+{
+    result sampled;
+    DataMemory dmem;
+    RegisterFile regs;
+    if (setup)
+        setup(dmem, setupContext);
+    Cpu cpu(image, dmem, regs);
+    cpu.setJitEnabled(jitEnabled);
+
+    // simulate the windows
+    unsigned int workers = threads ? threads : defaultThreads();
+    BoundedQueue<std::vector<unsigned char> > checkpoints(2 * workers);
+    std::vector<std::vector<sample> > found(workers); // by worker
+    std::vector<std::thread> pool;
+    for (unsigned int i = 0; i < workers; i++)
+        pool.push_back(std::thread([&, i]() {
+            std::vector<unsigned char> checkpoint;
+            while (checkpoints.pop(checkpoint))
+                found[i].push_back(measure(checkpoint));
+        }));
+
+    while ((cpu.getFunctionalInstructions() < maxInstructions) && !cpu.isHalted())
+    {
+        std::vector<unsigned char> checkpoint;
+        cpu.saveCheckpoint(checkpoint);
+        checkpoints.push(std::move(checkpoint));
+        unsigned long long remaining = maxInstructions - cpu.getFunctionalInstructions();
+        if (cpu.runFunctional((remaining < interval) ? remaining : interval) == 0)
+            break;
+    }
+    sampled.instructions = cpu.getFunctionalInstructions();
+    sampled.halted = cpu.isHalted();
+    checkpoints.close();
+    for (unsigned int i = 0; i < pool.size(); i++)
+        pool[i].join();
+
+    // back into program order
+    std::vector<sample> measured;
+    for (unsigned int i = 0; i < workers; i++)
+        measured.insert(measured.end(), found[i].begin(), found[i].end());
+    std::sort(measured.begin(), measured.end(),
+              [](const sample &a, const sample &b) { return a.instruction < b.instruction; });
+
+    // extrapolate.  The interval uses the normal approximation, which
+    // is close enough with the tens of samples a useful run takes.
+    double sum = 0.0;
+    double sumSquares = 0.0;
+    for (unsigned int i = 0; i < measured.size(); i++)
+    {
+        if (measured[i].retired == 0)
+            continue;
+        double cpi = (double)measured[i].cycles / (double)measured[i].retired;
+        sum += cpi;
+        sumSquares += cpi * cpi;
+        sampled.samples.push_back(measured[i]);
+    }
+    unsigned int n = sampled.samples.size();
+    sampled.cpi = n ? sum / n : 0.0;
+    sampled.cpiInterval = 0.0;
+    if (n > 1)
+    {
+        double variance = (sumSquares - n * sampled.cpi * sampled.cpi) / (n - 1);
+        sampled.cpiInterval = 1.96 * sqrt((variance > 0.0) ? variance / n : 0.0);
+    }
+    sampled.cycles = sampled.cpi * (double)sampled.instructions;
+    return sampled;
+}
@@ -0,0 +1,80 @@
+/*************************************************************************
+ * Sampler.h
+ *
+ * This file contains the class definition for the sampling driver.  A
+ * program is run with the functional model, a checkpoint is taken every
+ * so many instructions, and a short window of the pipeline model is
+ * simulated from each checkpoint.  The windows are independent and are
+ * simulated in parallel on the host's cores.  The CPI measured in the
+ * windows is extrapolated to the whole run, with a confidence interval.
+ *
+ * This code was developed as a demonstration for SER450 and is provided
+ * as-is as a learning aid for Chapter 4 of the class text.
+ *
+ * COPYRIGHT (C) 2019, Arizona State University
+ * ALL RIGHTS RESERVED
+ *
+ **************************************************************************/
+#ifndef SAMPLER_H
+#define SAMPLER_H
+#include <vector>
+#include "Cpu.h"
+#include "DataMemory.h"
+#include "ProgramImage.h"
+
+class Sampler
+{
+public:
+    // the measurement taken from one detailed window
+    typedef struct
+    {
+        unsigned long long instruction; // functional instructions before the checkpoint
+        unsigned long long cycles;      // cycles measured, after warm up
+        unsigned long long retired;     // instructions completed in those cycles
+    } sample;
+
+    // the result of a call to run()
+    typedef struct
+    {
+        unsigned long long instructions; // executed by the functional model
+        bool halted;                     // the program ran to completion
+        std::vector<sample> samples;     // in program order; windows that retired nothing are left out
+        double cpi;                      // the mean CPI of the samples
+        double cpiInterval;              // half width of the 95% confidence interval on cpi
+        double cycles;                   // the estimated cycles for the whole run
+    } result;
+
+    // called to prepare each data memory before a Cpu is built on it,
+    // for example to map the same data files into every one
+    typedef void (*memory_setup)(DataMemory &dmem, void *context);
+
+    Sampler(const ProgramImage &image);
+
+    // A checkpoint is taken every interval instructions, starting with the
+    // first, until the program halts or maxInstructions have been run.
+    // Each window simulates warmupCycles cycles, which fill the pipeline and
+    // are not measured, and then windowCycles measured cycles.  threads is
+    // the number of host threads simulating windows, 0 for one per core.
+    void setInterval(unsigned long long interval) { this->interval = interval; }
+    void setWindow(unsigned long long warmupCycles, unsigned long long windowCycles);
+    void setThreads(unsigned int threads) { this->threads = threads; }
+    void setMemorySetup(memory_setup setup, void *context);
+    void setJitEnabled(bool enabled) { jitEnabled = enabled; }
+
+    result run(unsigned long long maxInstructions);
+
+private:
+    const ProgramImage &image;
+    unsigned long long interval;
+    unsigned long long warmupCycles;
+    unsigned long long windowCycles;
+    unsigned int threads;
+    bool jitEnabled;
+    memory_setup setup;
+    void *setupContext;
+
+    // simulate the window that starts at a checkpoint
+    sample measure(const std::vector<unsigned char> &checkpoint) const;
+};
+
+#endif // SAMPLER_H
@@ -0,0 +1,350 @@
+/*************************************************************************
+ * TraceDiff.cpp
+ *
+ * This file contains the class implementation for the trace comparer.
+ *
+ * This code was developed as a demonstration for SER450 and is provided
+ * as-is as a learning aid for Chapter 4 of the class text.
+ *
+ * COPYRIGHT (C) 2019, Arizona State University
+ * ALL RIGHTS RESERVED
+ *
+ **************************************************************************/
+#include <stdio.h>
+#include <string.h>
+#include <algorithm>
+#include <atomic>
+#include <memory>
+#include <vector>
+#include "Parallel.h"
+#include "TraceDiff.h"
+
+#define BLOCKS_PER_CHUNK 4         // binary traces are compared this many blocks at a time
+#define TEXT_CHUNK_SIZE (1u << 20) // and text traces this many bytes at a time
+
+static const char *const stageNames[5] = {"IF", "ID", "EXE", "MEM", "WB"};
+
+// lower a shared value to value, if it is smaller
+template <typename T>
+static void lowerTo(std::atomic<T> &shared, T value)
+{
+    T seen = shared.load();
+    while ((value < seen) && !shared.compare_exchange_weak(seen, value))
+        ;
+}
+
+static std::string hexString(unsigned int value)
+{
+    char text[16];
+    snprintf(text, sizeof(text), "%08x", value);
+    return text;
+}
+
+//********************************************
+// binary traces
+//
+// A cursor reads the cycles of one trace in order,
+// starting from a given block.
+typedef struct
+{
+    const BinaryTraceReader *reader;
+    unsigned int block;
+    unsigned int endBlock;  // the cursor stops before this block
+    BinaryTraceReader::Decoder decoder;
+    trace_cycle cycle;      // the current cycle, if valid
+    bool valid;
+    bool blockStart;        // cycle is the first in its block
+} trace_cursor;
+
+static void advanceCursor(trace_cursor &cursor)
+{
+    cursor.blockStart = false;
+    while (!cursor.decoder.next(cursor.cycle))
+    {
+        if (++cursor.block >= cursor.endBlock)
+        {
+            cursor.valid = false;
+            return;
+        }
+        cursor.reader->decodeBlock(cursor.block, cursor.decoder);
+        cursor.blockStart = true;
+    }
+    cursor.valid = true;
+}
+
+static void seekCursor(trace_cursor &cursor, unsigned int block)
+{
+    cursor.block = block;
+    cursor.valid = false;
+    if (block >= cursor.endBlock)
+        return;
+    cursor.reader->decodeBlock(block, cursor.decoder);
+    cursor.valid = cursor.decoder.next(cursor.cycle);
+    cursor.blockStart = true;
+    if (!cursor.valid)
+        advanceCursor(cursor);
+}
+
+// true if the current blocks of two cursors hold the same bytes
+static bool sameBlocks(const trace_cursor &first, const trace_cursor &second)
+{
+    unsigned int firstLength, secondLength;
+    const unsigned char *firstData = first.reader->blockData(first.block, firstLength);
+    const unsigned char *secondData = second.reader->blockData(second.block, secondLength);
+    return (firstLength == secondLength) && (memcmp(firstData, secondData, firstLength) == 0);
+}
+
+// Compare the current cycles of two cursors, filling in what differs
+// first.  Returns false if they match.
+static bool compareCycles(const trace_cursor &first, const trace_cursor &second, TraceDiff::difference &found)
+{
+    found.found = true;
+    found.cycleKnown = true;
+    found.line = 0;
+    found.haveStates = false;
+    if (!first.valid || !second.valid)
+    {
+        found.cycle = first.valid ? first.cycle.cycle : second.cycle.cycle;
+        found.field = "end of trace";
+        found.first = first.valid ? "continues" : "ended";
+        found.second = second.valid ? "continues" : "ended";
+        return true;
+    }
+    const trace_cycle &a = first.cycle;
+    const trace_cycle &b = second.cycle;
+    found.cycle = std::min(a.cycle, b.cycle);
+    if (a.cycle != b.cycle)
+    {
+        found.field = "cycle";
+        found.first = std::to_string(a.cycle);
+        found.second = std::to_string(b.cycle);
+        return true;
+    }
+    found.haveStates = true;
+    found.states[0] = a;
+    found.states[1] = b;
+    if (a.pc != b.pc)
+    {
+        found.field = "PC";
+        found.first = hexString(a.pc);
+        found.second = hexString(b.pc);
+        return true;
+    }
+    for (unsigned int i = 0; i < 5; i++)
+    {
+        if (a.stages[i] == b.stages[i])
+            continue;
+        found.field = stageNames[i];
+        found.first = hexString(a.stages[i]);
+        found.second = hexString(b.stages[i]);
+        return true;
+    }
+    for (unsigned int i = 0; i < 32; i++)
+    {
+        if (a.regs[i] == b.regs[i])
+            continue;
+        char name[8];
+        snprintf(name, sizeof(name), "R%02x", i);
+        found.field = name;
+        found.first = hexString(a.regs[i]);
+        found.second = hexString(b.regs[i]);
+        return true;
+    }
+    if (a.events != b.events)
+    {
+        found.field = "events";
+        found.first = hexString(a.events);
+        found.second = hexString(b.events);
+        return true;
+    }
+    found.found = false;
+    return false;
+}
+
+//********************************************
+// compareBinary
+// Each chunk is a run of blocks of the first trace,
+// compared with the same cycles of the second.  The
+// first trace's block boundaries need not match the
+// second's, but when they do, blocks with the same
+// bytes are skipped without decoding.
+void TraceDiff::compareBinary(const BinaryTraceReader &first, const BinaryTraceReader &second, unsigned int threads)
+{
+    unsigned int blockCount = first.blockCount();
+    unsigned int chunkCount = std::max(1u, (blockCount + BLOCKS_PER_CHUNK - 1) / BLOCKS_PER_CHUNK);
+    std::vector<difference> found(chunkCount);
+    std::atomic<unsigned int> firstChunk(chunkCount);
+
+    parallelFor(chunkCount, threads, [&](unsigned int chunk) {
+        if (chunk > firstChunk.load())
+            return;
+        unsigned int startBlock = chunk * BLOCKS_PER_CHUNK;
+        unsigned int endBlock = std::min(startBlock + BLOCKS_PER_CHUNK, blockCount);
+        unsigned long long startCycle = (startBlock < blockCount) ? first.blockFirstCycle(startBlock) : 0;
+        unsigned long long limitCycle = (endBlock < blockCount) ? first.blockFirstCycle(endBlock) : ~0ull;
+
+        std::unique_ptr<trace_cursor> a(new trace_cursor());
+        a->reader = &first;
+        a->endBlock = endBlock;
+        seekCursor(*a, startBlock);
+
+        // the second trace starts from the last block at or before the
+        // chunk's first cycle (or from its beginning, for the first chunk)
+        std::unique_ptr<trace_cursor> b(new trace_cursor());
+        b->reader = &second;
+        b->endBlock = second.blockCount();
+        unsigned int low = 0, high = second.blockCount();
+        while ((chunk > 0) && (high - low > 1))
+        {
+            unsigned int middle = (low + high) / 2;
+            if (second.blockFirstCycle(middle) <= startCycle)
+                low = middle;
+            else
+                high = middle;
+        }
+        seekCursor(*b, low);
+        while ((chunk > 0) && b->valid && (b->cycle.cycle < startCycle))
+            advanceCursor(*b);
+
+        for (;;)
+        {
+            if (b->valid && (b->cycle.cycle >= limitCycle))
+                b->valid = false; // it belongs to the next chunk
+            if (!a->valid && !b->valid)
+                return;
+            if (a->valid && b->valid && a->blockStart && b->blockStart && sameBlocks(*a, *b))
+            {
+                seekCursor(*a, a->block + 1);
+                seekCursor(*b, b->block + 1);
+                continue;
+            }
+            if (compareCycles(*a, *b, found[chunk]))
+            {
+                lowerTo(firstChunk, chunk);
+                return;
+            }
+            advanceCursor(*a);
+            advanceCursor(*b);
+        }
+    });
+
+    if (firstChunk.load() < chunkCount)
+        result = found[firstChunk.load()];
+}
+
+//********************************************
+// text traces
+//
+// the line of a text trace that starts at offset
+static std::string textLine(const MappedFile &file, size_t offset)
+{
+    if (offset >= file.size())
+        return "(end of file)";
+    const char *start = (const char *)file.data() + offset;
+    const char *end = (const char *)memchr(start, '\n', file.size() - offset);
+    return std::string(start, end ? end : (const char *)file.data() + file.size());
+}
+
+// the start of the line before the one starting at offset
+static size_t previousLine(const unsigned char *data, size_t offset)
+{
+    offset--;
+    while ((offset > 0) && (data[offset - 1] != '\n'))
+        offset--;
+    return offset;
+}
+
+//********************************************
+// compareText
+// The chunks find the first byte that differs, and the
+// line around it is then examined for what it holds.
+void TraceDiff::compareText(const MappedFile &first, const MappedFile &second, unsigned int threads)
+{
+    const unsigned char *a = first.data();
+    const unsigned char *b = second.data();
+    size_t length = std::min(first.size(), second.size());
+    unsigned int chunkCount = (length + TEXT_CHUNK_SIZE - 1) / TEXT_CHUNK_SIZE;
+    std::atomic<size_t> firstOffset(length);
+
+    parallelFor(chunkCount, threads, [&](unsigned int chunk) {
+        size_t start = (size_t)chunk * TEXT_CHUNK_SIZE;
+        if (start >= firstOffset.load())
+            return;
+        size_t size = std::min((size_t)TEXT_CHUNK_SIZE, length - start);
+        if (memcmp(a + start, b + start, size) == 0)
+            return;
+        size_t offset = start;
+        while (a[offset] == b[offset])
+            offset++;
+        lowerTo(firstOffset, offset);
+    });
+
+    size_t offset = firstOffset.load();
+    if ((offset == length) && (first.size() == second.size()))
+        return;
+
+    // the line that differs, which starts the same in both traces
+    size_t lineStart = offset;
+    while ((lineStart > 0) && (a[lineStart - 1] != '\n'))
+        lineStart--;
+    result.found = true;
+    result.haveStates = false;
+    result.line = 1 + std::count(a, a + lineStart, '\n');
+    result.first = textLine(first, lineStart);
+    result.second = textLine(second, lineStart);
+
+    // the cycle is the last one started at or before the line
+    result.cycleKnown = false;
+    for (size_t line = lineStart;; line = previousLine(a, line))
+    {
+        if ((length - line >= 13) && (memcmp(a + line, "Clock Cycle: ", 13) == 0))
+        {
+            result.cycleKnown = true;
+            result.cycle = strtoull((const char *)a + line + 13, 0, 10);
+            break;
+        }
+        if (line == 0)
+            break;
+    }
+
+    // name what the line holds: the cycle number, a pipeline stage, or
+    // one register of a register file line
+    const std::string &text = (offset < first.size()) ? result.first : result.second;
+    size_t column = offset - lineStart;
+    size_t colon = text.find(':');
+    if ((offset >= first.size()) || (offset >= second.size()))
+        result.field = "end of trace";
+    else if (text.compare(0, 13, "Clock Cycle: ") == 0)
+        result.field = "cycle";
+    else if ((text.size() >= 4) && (text[0] == 'R') && (colon == 3))
+        result.field = text.substr((column / 14) * 14, 3); // "Rxx: xxxxxxxx " per register
+    else if (colon < 4)
+        result.field = text.substr(0, colon);
+    else if (text.compare(0, 10, "Forwarding") == 0)
+        result.field = "forwarding";
+    else
+        result.field = "line";
+}
+
+//********************************************
+// compare
+bool TraceDiff::compare(const char *first, const char *second, unsigned int threads)
+{
+    result = difference();
+    BinaryTraceReader firstReader, secondReader;
+    bool firstBinary = firstReader.open(first);
+    bool secondBinary = secondReader.open(second);
+    if (firstBinary && secondBinary)
+    {
+        compareBinary(firstReader, secondReader, threads);
+        return true;
+    }
+    if (firstBinary || secondBinary)
+        return false;
+
+    MappedFile firstFile, secondFile;
+    if (!firstFile.open(first) || !secondFile.open(second))
+        return false;
+    compareText(firstFile, secondFile, threads);
+    return true;
+}
@@ -0,0 +1,59 @@
+/*************************************************************************
+ * TraceDiff.h
+ *
+ * This file contains the class definition for the trace comparer, which
+ * finds the first clock cycle at which two simulator traces differ, and
+ * what differs in it: a pipeline stage, a register, the events, or one
+ * trace ending early.  Traces are either binary traces (BinaryTrace.h)
+ * or text output such as the golden output files.
+ *
+ * Both files are memory-mapped and read once, front to back, split into
+ * chunks that are compared on a pool of threads.  Chunks after one that
+ * has already been found to differ are skipped.  Binary blocks whose
+ * bytes match are skipped without being decoded.
+ *
+ * This code was developed as a demonstration for SER450 and is provided
+ * as-is as a learning aid for Chapter 4 of the class text.
+ *
+ * COPYRIGHT (C) 2019, Arizona State University
+ * ALL RIGHTS RESERVED
+ *
+ **************************************************************************/
+#ifndef TRACEDIFF_H
+#define TRACEDIFF_H
+#include <stddef.h>
+#include <string>
+#include "BinaryTrace.h"
+#include "MappedFile.h"
+
+class TraceDiff
+{
+public:
+    typedef struct
+    {
+        bool found;               // false if the traces match
+        bool cycleKnown;          // false for text before the first "Clock Cycle:" line
+        unsigned long long cycle; // the clock cycle that differs
+        std::string field;        // what differs: "IF".."WB", "PC", "R08", "events", "cycle", "end of trace", ...
+        std::string first;        // its value in each trace (for text, the whole line)
+        std::string second;
+        size_t line;              // text traces: the line number, counting from 1
+        bool haveStates;          // binary traces that both hold the cycle:
+        trace_cycle states[2];    // the cycle in each trace
+    } difference;
+
+    // Compare two traces of the same kind on up to threads threads (0 for
+    // one per core).  Returns false if either can't be read, or one is a
+    // binary trace and the other isn't.
+    bool compare(const char *first, const char *second, unsigned int threads = 0);
+
+    const difference &getDifference() const { return result; }
+
+private:
+    difference result;
+
+    void compareBinary(const BinaryTraceReader &first, const BinaryTraceReader &second, unsigned int threads);
+    void compareText(const MappedFile &first, const MappedFile &second, unsigned int threads);
+};
+
+#endif // TRACEDIFF_H
@@ -0,0 +1,159 @@
+/*************************************************************************
+ * TraceSink.cpp
+ *
+ * This file contains the class implementation for the trace sink.
+ *
+ * This code was developed as a demonstration for SER450 and is provided
+ * as-is as a learning aid for Chapter 4 of the class text.
+ *
+ * COPYRIGHT (C) 2019, Arizona State University
+ * ALL RIGHTS RESERVED
+ *
+ **************************************************************************/
+#include <charconv>
+#include <chrono>
+#include "TraceSink.h"
+
+//********************************************
+// Constructor
+TraceSink::TraceSink(FILE *out, bool background, unsigned int bufferSize)
+    : out(out), head(0), tail(0), stopping(false), background(background)
+{
+    size_t size = 4096;
+    while (size < bufferSize)
+        size <<= 1;
+    ring.resize(size);
+    mask = size - 1;
+    if (background)
+        writer = std::thread(&TraceSink::writerLoop, this);
+}
+
+//********************************************
+// Destructor
+TraceSink::~TraceSink()
+{
+    if (background)
+    {
+        stopping.store(true, std::memory_order_release);
+        writer.join();
+    }
+    else
+        writeSome(tail.load(std::memory_order_relaxed), head.load(std::memory_order_relaxed));
+    fflush(out);
+}
+
+//********************************************
+// writeSome
+// write the bytes between two ring positions
+size_t TraceSink::writeSome(size_t from, size_t to)
+{
+    while (from != to)
+    {
+        size_t start = from & mask;
+        size_t length = to - from;
+        if (length > ring.size() - start)
+            length = ring.size() - start; // up to the end of the ring
+        fwrite(&ring[start], 1, length, out);
+        from += length;
+        tail.store(from, std::memory_order_release);
+    }
+    return from;
+}
+
+//********************************************
+// writerLoop
+// The background thread writes whatever the producer
+// has added, and sleeps briefly when there is nothing.
+void TraceSink::writerLoop()
+{
+    size_t position = tail.load(std::memory_order_relaxed);
+    bool written = false;
+    for (;;)
+    {
+        bool stop = stopping.load(std::memory_order_acquire);
+        size_t end = head.load(std::memory_order_acquire);
+        if (end != position)
+        {
+            position = writeSome(position, end);
+            written = true;
+            continue;
+        }
+        if (stop)
+            return;
+        if (written)
+        {
+            fflush(out);
+            written = false;
+        }
+        std::this_thread::sleep_for(std::chrono::microseconds(100));
+    }
+}
+
+//********************************************
+// text
+// Copy text into the ring, waiting for the writer
+// (or writing the ring here) when it is full.
+TraceSink &TraceSink::text(const char *s, size_t length)
+{
+    size_t position = head.load(std::memory_order_relaxed);
+    while (length)
+    {
+        size_t space = ring.size() - (position - tail.load(std::memory_order_acquire));
+        if (space == 0)
+        {
+            if (background)
+                std::this_thread::yield();
+            else
+                writeSome(tail.load(std::memory_order_relaxed), position);
+            continue;
+        }
+        size_t start = position & mask;
+        size_t count = length;
+        if (count > space)
+            count = space;
+        if (count > ring.size() - start)
+            count = ring.size() - start;
+        memcpy(&ring[start], s, count);
+        s += count;
+        length -= count;
+        position += count;
+        head.store(position, std::memory_order_release);
+    }
+    return *this;
+}
+
+TraceSink &TraceSink::number(unsigned long long value)
+{
+    char digits[24];
+    std::to_chars_result result = std::to_chars(digits, digits + sizeof(digits), value);
+    return text(digits, result.ptr - digits);
+}
+
+TraceSink &TraceSink::operator<<(int value)
+{
+    char digits[16];
+    std::to_chars_result result = std::to_chars(digits, digits + sizeof(digits), value);
+    return text(digits, result.ptr - digits);
+}
+
+TraceSink &TraceSink::hex(unsigned int value, unsigned int digits)
+{
+    char buffer[16];
+    std::to_chars_result result = std::to_chars(buffer + 8, buffer + sizeof(buffer), value, 16);
+    char *start = buffer + 8;
+    while ((result.ptr - start < (long)digits) && (start > buffer))
+        *--start = '0';
+    return text(start, result.ptr - start);
+}
+
+//********************************************
+// flush
+void TraceSink::flush()
+{
+    size_t end = head.load(std::memory_order_relaxed);
+    if (!background)
+        writeSome(tail.load(std::memory_order_relaxed), end);
+    while (tail.load(std::memory_order_acquire) != end)
+        std::this_thread::yield();
+    fflush(out);
+}
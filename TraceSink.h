@@ -0,0 +1,68 @@
+/*************************************************************************
+ * TraceSink.h
+ *
+ * This file contains the class definition for a trace sink: a buffered
+ * text output stream for simulator traces.  Text is formatted straight
+ * into a large ring buffer, and a background thread writes the buffer to
+ * the output file, so the simulation thread only waits if it gets a whole
+ * buffer ahead of the disk.  The ring has one producer and one consumer
+ * and needs no locks.  A sink can also run without the thread, writing
+ * the buffer itself whenever it fills.
+ *
+ * A sink must only be written by one thread, and nothing else should
+ * write to its output file while it is in use.
+ *
+ * This code was developed as a demonstration for SER450 and is provided
+ * as-is as a learning aid for Chapter 4 of the class text.
+ *
+ * COPYRIGHT (C) 2019, Arizona State University
+ * ALL RIGHTS RESERVED
+ *
+ **************************************************************************/
+#ifndef TRACESINK_H
+#define TRACESINK_H
+#include <stdio.h>
+#include <string.h>
+#include <atomic>
+#include <thread>
+#include <vector>
+
+class TraceSink
+{
+public:
+    // bufferSize is rounded up to a power of two
+    TraceSink(FILE *out, bool background = true, unsigned int bufferSize = 1u << 22);
+    ~TraceSink(); // writes anything still buffered
+
+    TraceSink &text(const char *s, size_t length);
+    TraceSink &number(unsigned long long value);
+    TraceSink &hex(unsigned int value, unsigned int digits = 8); // zero padded to digits
+
+    TraceSink &operator<<(const char *s) { return text(s, strlen(s)); }
+    TraceSink &operator<<(char c) { return text(&c, 1); }
+    TraceSink &operator<<(unsigned long long value) { return number(value); }
+    TraceSink &operator<<(unsigned int value) { return number(value); }
+    TraceSink &operator<<(int value);
+
+    // wait until everything written so far has reached the file
+    void flush();
+
+private:
+    FILE *out;
+    std::vector<char> ring;
+    size_t mask;
+    std::atomic<size_t> head; // total bytes added by the producer
+    std::atomic<size_t> tail; // total bytes written to the file
+    std::atomic<bool> stopping;
+    std::thread writer;
+    bool background;
+
+    void writerLoop();
+    size_t writeSome(size_t from, size_t to); // write ring bytes, returning the new tail
+
+    // not copyable
+    TraceSink(const TraceSink &);
+    TraceSink &operator=(const TraceSink &);
+};
+
+#endif // TRACESINK_H
@@ -0,0 +1,54 @@
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include "Batch.h"
+
+// Run every job in a manifest (lines of "<program_file> <num_cycles>") on a
+// pool of threads and write one JSON result per job, in manifest order.
+int main(int argc, char *argv[])
+{
+    // the manifest, optionally followed by -t <threads> and -o <result_file>
+    // (the results go to the standard output otherwise)
+    unsigned int threads = 0;
+    std::string resultFile;
+    bool validArguments = (argc >= 2);
+    for (int i = 2; validArguments && (i < argc); i++)
+    {
+        std::string option = argv[i];
+        if ((option == "-t") && (i + 1 < argc))
+            std::istringstream(argv[++i]) >> threads;
+        else if ((option == "-o") && (i + 1 < argc))
+            resultFile = argv[++i];
+        else
+            validArguments = false;
+    }
+    if (!validArguments)
+    {
+        std::cerr << "Usage: " << argv[0] << " <manifest> [-t <threads>] [-o <result_file>]" << std::endl;
+        return 1;
+    }
+
+    Batch batch;
+    if (!batch.loadManifest(argv[1]))
+    {
+        std::cerr << "Error: Unable to read manifest " << argv[1] << std::endl;
+        return 1;
+    }
+    batch.run(threads);
+
+    if (resultFile.empty())
+    {
+        batch.writeResults(std::cout);
+        return 0;
+    }
+    std::ofstream out(resultFile.c_str());
+    batch.writeResults(out);
+    out.close();
+    if (!out)
+    {
+        std::cerr << "Error: Unable to write " << resultFile << std::endl;
+        return 1;
+    }
+    return 0;
+}
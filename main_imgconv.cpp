@@ -0,0 +1,33 @@
+#include <iostream>
+#include <string>
+#include "ProgramImage.h"
+
+// Convert a program from the text format ("address type value" hex triples)
+// to a binary image that the simulators can map and start without parsing.
+int main(int argc, char *argv[])
+{
+    // -n leaves the predecoded instruction section out of the image
+    bool predecoded = !((argc == 4) && (std::string(argv[3]) == "-n"));
+    if ((argc != 3) && predecoded)
+    {
+        std::cerr << "Usage: " << argv[0] << " <input_file> <image_file> [-n]" << std::endl;
+        return 1; // Exit with an error code
+    }
+
+    // a binary input image is converted again (to add or drop the
+    // predecoded section), so its checksum is checked first
+    ProgramImage image;
+    if (!image.load(argv[1], true))
+    {
+        std::cerr << "Error: Unable to load file " << argv[1] << std::endl;
+        return 1;
+    }
+    if (!image.saveBinary(argv[2], predecoded))
+    {
+        std::cerr << "Error: Unable to write image " << argv[2] << std::endl;
+        return 1;
+    }
+
+    std::cout << "Wrote " << argv[2] << std::endl;
+    return 0;
+}
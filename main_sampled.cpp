@@ -0,0 +1,93 @@
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+#include "ProgramImage.h"
+#include "Sampler.h"
+
+// the data files to map into every data memory, as (address, filename) pairs
+typedef std::vector<std::pair<unsigned int, std::string> > mapped_files;
+
+static void mapFiles(DataMemory &dmem, void *context)
+{
+    const mapped_files &files = *(const mapped_files *)context;
+    for (unsigned int i = 0; i < files.size(); i++)
+        dmem.mapFile(files[i].first, files[i].second.c_str());
+}
+
+// Estimate the cycles a program takes by sampling: the program runs with the
+// functional model and short windows of the pipeline model are simulated in
+// parallel from checkpoints taken along the way.
+int main(int argc, char *argv[])
+{
+    // the filename and the instruction limit, optionally followed by
+    // -i <interval> (instructions between samples), -w <warmup> <window>
+    // (cycles in each window), -t <threads> and any number of
+    // -m <hex_address> <data_file>
+    unsigned long long interval = 100000;
+    unsigned long long warmup = 100;
+    unsigned long long window = 2000;
+    unsigned int threads = 0;
+    mapped_files files;
+    bool validArguments = (argc >= 3);
+    for (int i = 3; validArguments && (i < argc); i++)
+    {
+        std::string option = argv[i];
+        if ((option == "-i") && (i + 1 < argc))
+            std::istringstream(argv[++i]) >> interval;
+        else if ((option == "-w") && (i + 2 < argc))
+        {
+            std::istringstream(argv[i + 1]) >> warmup;
+            std::istringstream(argv[i + 2]) >> window;
+            i += 2;
+        }
+        else if ((option == "-t") && (i + 1 < argc))
+            std::istringstream(argv[++i]) >> threads;
+        else if ((option == "-m") && (i + 2 < argc))
+        {
+            unsigned int address;
+            std::istringstream(argv[i + 1]) >> std::hex >> address;
+            files.push_back(std::make_pair(address, std::string(argv[i + 2])));
+            i += 2;
+        }
+        else
+            validArguments = false;
+    }
+    if ((!validArguments) || (interval == 0))
+    {
+        std::cerr << "Usage: " << argv[0] << " <filename> <max_instructions> [-i <interval>] [-w <warmup> <window>]"
+                  << " [-t <threads>] [-m <address> <data_file>]..." << std::endl;
+        return 1;
+    }
+    unsigned long long maxInstructions;
+    std::istringstream(argv[2]) >> maxInstructions;
+
+    ProgramImage image;
+    if (!image.load(argv[1]))
+    {
+        std::cerr << "Error: Unable to load file " << argv[1] << std::endl;
+        return 1;
+    }
+    for (unsigned int i = 0; i < files.size(); i++)
+    {
+        DataMemory probe;
+        if (!probe.mapFile(files[i].first, files[i].second.c_str()))
+        {
+            std::cerr << "Error: Unable to map " << files[i].second << std::endl;
+            return 1;
+        }
+    }
+
+    Sampler sampler(image);
+    sampler.setInterval(interval);
+    sampler.setWindow(warmup, window);
+    sampler.setThreads(threads);
+    sampler.setMemorySetup(mapFiles, &files);
+    Sampler::result result = sampler.run(maxInstructions);
+
+    std::cout << "Instructions: " << result.instructions << (result.halted ? " (program finished)" : "") << std::endl;
+    std::cout << "Samples: " << result.samples.size() << std::endl;
+    std::cout << "CPI: " << result.cpi << " +/- " << result.cpiInterval << " (95%)" << std::endl;
+    std::cout << "Estimated cycles: " << (unsigned long long)(result.cycles + 0.5) << std::endl;
+    return 0;
+}
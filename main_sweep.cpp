@@ -0,0 +1,53 @@
+#include <iostream>
+#include <sstream>
+#include <vector>
+#include "Lockstep.h"
+#include "ProgramImage.h"
+
+// Run one program over several sets of data in lockstep.  Each data file
+// uses the program text format; its data lines are loaded, after the
+// program's own data, into the memory of one lane.
+int main(int argc, char *argv[])
+{
+    if (argc < 4)
+    {
+        std::cerr << "Usage: " << argv[0] << " <filename> <max_steps> <data_file>..." << std::endl;
+        return 1;
+    }
+    unsigned long long maxSteps;
+    std::istringstream(argv[2]) >> maxSteps;
+
+    ProgramImage image;
+    if (!image.load(argv[1]))
+    {
+        std::cerr << "Error: Unable to load file " << argv[1] << std::endl;
+        return 1;
+    }
+
+    Lockstep machines(image, argc - 3);
+    for (int i = 3; i < argc; i++)
+    {
+        ProgramImage data;
+        if (!data.load(argv[i]))
+        {
+            std::cerr << "Error: Unable to load file " << argv[i] << std::endl;
+            return 1;
+        }
+        data.loadData(machines.memory(i - 3));
+    }
+    machines.run(maxSteps);
+
+    // a line for each lane with its halt state and registers
+    static const char *statusNames[] = {"running", "self loop", "break", "predicate"};
+    for (unsigned int lane = 0; lane < machines.lanes(); lane++)
+    {
+        std::cout << "Lane " << lane << " (" << argv[lane + 3] << "): " << statusNames[machines.status(lane)]
+                  << ", PC = " << std::hex << machines.pc(lane) << std::endl;
+        for (unsigned int r = 0; r < 32; r++)
+            std::cout << (r ? " " : "") << machines.reg(lane, r);
+        std::cout << std::dec << std::endl;
+    }
+    std::cout << "Steps: " << machines.getSteps() << ", lane instructions: " << machines.getLaneInstructions()
+              << std::endl;
+    return 0;
+}
@@ -0,0 +1,64 @@
+#include <iostream>
+#include <sstream>
+#include <string>
+#include "TraceDiff.h"
+#include "TraceSink.h"
+
+// Compare two simulator traces (binary traces or text output such as the
+// golden output files) and report the first clock cycle at which they
+// differ.  Exits with 0 if they match, 1 if they differ and 2 on an error,
+// as diff does.
+int main(int argc, char *argv[])
+{
+    // the two traces, optionally followed by -t <threads>
+    unsigned int threads = 0;
+    bool validArguments = (argc >= 3);
+    for (int i = 3; validArguments && (i < argc); i++)
+    {
+        std::string option = argv[i];
+        if ((option == "-t") && (i + 1 < argc))
+            std::istringstream(argv[++i]) >> threads;
+        else
+            validArguments = false;
+    }
+    if (!validArguments)
+    {
+        std::cerr << "Usage: " << argv[0] << " <first_trace> <second_trace> [-t <threads>]" << std::endl;
+        return 2;
+    }
+
+    TraceDiff diff;
+    if (!diff.compare(argv[1], argv[2], threads))
+    {
+        std::cerr << "Error: Unable to compare " << argv[1] << " and " << argv[2]
+                  << " (both must be readable, and both binary traces or both text)" << std::endl;
+        return 2;
+    }
+    const TraceDiff::difference &found = diff.getDifference();
+    if (!found.found)
+    {
+        std::cout << "The traces match" << std::endl;
+        return 0;
+    }
+
+    std::cout << "First difference";
+    if (found.cycleKnown)
+        std::cout << " at clock cycle " << found.cycle;
+    if (found.line)
+        std::cout << " (line " << found.line << ")";
+    std::cout << ": " << found.field << std::endl;
+    std::cout << "  " << argv[1] << ": " << found.first << std::endl;
+    std::cout << "  " << argv[2] << ": " << found.second << std::endl;
+
+    // binary traces hold the whole state of the cycle
+    if (found.haveStates)
+    {
+        std::cout << std::endl;
+        TraceSink out(stdout, false);
+        out << argv[1] << ":\n";
+        dumpTraceCycle(found.states[0], out);
+        out << argv[2] << ":\n";
+        dumpTraceCycle(found.states[1], out);
+    }
+    return 1;
+}
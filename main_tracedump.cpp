@@ -0,0 +1,69 @@
+#include <iostream>
+#include <sstream>
+#include <string>
+#include "BinaryTrace.h"
+#include "TraceSink.h"
+
+// Print a binary trace (written by the simulator's -b option) in the format
+// of Cpu::dump, one dump per clock cycle.
+int main(int argc, char *argv[])
+{
+    // the trace, optionally followed by -c <first_cycle> <last_cycle> to
+    // print only those cycles and -e to print each cycle's events
+    unsigned long long firstCycle = 0;
+    unsigned long long lastCycle = ~0ull;
+    bool printEvents = false;
+    bool validArguments = (argc >= 2);
+    for (int i = 2; validArguments && (i < argc); i++)
+    {
+        std::string option = argv[i];
+        if ((option == "-c") && (i + 2 < argc))
+        {
+            std::istringstream(argv[i + 1]) >> firstCycle;
+            std::istringstream(argv[i + 2]) >> lastCycle;
+            i += 2;
+        }
+        else if (option == "-e")
+            printEvents = true;
+        else
+            validArguments = false;
+    }
+    if (!validArguments)
+    {
+        std::cerr << "Usage: " << argv[0] << " <trace_file> [-c <first_cycle> <last_cycle>] [-e]" << std::endl;
+        return 1;
+    }
+
+    BinaryTraceReader reader;
+    if (!reader.open(argv[1]))
+    {
+        std::cerr << "Error: " << argv[1] << " is not a binary trace" << std::endl;
+        return 1;
+    }
+
+    // skip the blocks that end before the first cycle wanted
+    unsigned int block = 0;
+    while ((block + 1 < reader.blockCount()) && (reader.blockFirstCycle(block + 1) <= firstCycle))
+        block++;
+
+    TraceSink out(stdout);
+    BinaryTraceReader::Decoder decoder;
+    trace_cycle cycle;
+    for (; block < reader.blockCount(); block++)
+    {
+        if (reader.blockFirstCycle(block) > lastCycle)
+            break;
+        reader.decodeBlock(block, decoder);
+        while (decoder.next(cycle))
+        {
+            if ((cycle.cycle < firstCycle) || (cycle.cycle > lastCycle))
+                continue;
+            dumpTraceCycle(cycle, out);
+            if (printEvents)
+                for (unsigned int i = 0; i < TRACE_EVENT_COUNT; i++)
+                    if (cycle.events & (1u << i))
+                        out << traceEventName(1u << i) << "\n";
+        }
+    }
+    return 0;
+}
@@ -1,17 +1,55 @@
-#include <iostream>
 #include <fstream>
+#include <iostream>
 #include <sstream>
+#include <vector>
 #include "DataMemory.h"
-#include "InstructionMemory.h"
+#include "ProgramImage.h"
 #include "RegisterFile.h"
+#include "TraceSink.h"
+#include "BinaryTrace.h"
+#include "Profiler.h"
 #include "Cpu.h"
 
 int main(int argc, char *argv[])
 {
     // Check if a filename and the number of cycles are provided as command-line arguments
-    if (argc != 3)
+    // (optionally followed by -f to print each forwarding event, -b <trace_file> to record
+    // every cycle to a binary trace, -p <profile_name> to write a per-pc profile to
+    // <profile_name>.txt and flamegraph folded stacks to <profile_name>.folded, -j <json_file>
+    // to write the performance counters as JSON at the end of the run (and with -i <cycles>,
+    // every that many cycles as well), and any number of -m <hex_address> <data_file> to map
+    // a data file into data memory at that address)
+    bool logForwarding = false;
+    const char *binaryTraceFile = 0;
+    std::string profileName;
+    const char *countersFile = 0;
+    unsigned long long countersInterval = 0;
+    bool validArguments = (argc >= 3);
+    std::vector<int> mappedFiles; // the argv index of each -m option
+    for (int i = 3; validArguments && (i < argc); i++)
     {
-        std::cerr << "Usage: " << argv[0] << " <filename> <num_cycles>" << std::endl;
+        std::string option = argv[i];
+        if (option == "-f")
+            logForwarding = true;
+        else if ((option == "-b") && (i + 1 < argc))
+            binaryTraceFile = argv[++i];
+        else if ((option == "-p") && (i + 1 < argc))
+            profileName = argv[++i];
+        else if ((option == "-j") && (i + 1 < argc))
+            countersFile = argv[++i];
+        else if ((option == "-i") && (i + 1 < argc))
+            std::istringstream(argv[++i]) >> countersInterval;
+        else if ((option == "-m") && (i + 2 < argc))
+        {
+            mappedFiles.push_back(i);
+            i += 2;
+        }
+        else
+            validArguments = false;
+    }
+    if (!validArguments)
+    {
+        std::cerr << "Usage: " << argv[0] << " <filename> <num_cycles> [-f] [-b <trace_file>] [-p <profile_name>] [-j <json_file> [-i <cycles>]] [-m <address> <data_file>]..." << std::endl;
         return 1; // Exit with an error code
     }
 
@@ -25,62 +63,115 @@ int main(int argc, char *argv[])
     std::cout << "Akhil Matthews" << std::endl;
     std::cout << "--------------------------------" << std::endl;
 
-    // Create instances of each class
+    // Load the program from the specified file (text or binary image)
+    ProgramImage image;
+    if (!image.load(filename.c_str()))
+    {
+        std::cerr << "Error: Unable to load file " << filename << std::endl;
+        return 1; // Exit with an error code
+    }
+
+    // Create the cpu state and the cpu that runs the program image
     DataMemory dataMemory;
-    InstructionMemory instructionMemory;
     RegisterFile registerFile;
-    Cpu cpu(dataMemory, registerFile);
-
-    // Load program code into instruction memory from the specified file
-    std::ifstream inputFile(filename);
-    if (!inputFile.is_open())
+    for (unsigned int i = 0; i < mappedFiles.size(); i++)
     {
-        std::cerr << "Error: Unable to open file " << filename << std::endl;
-        return 1; // Exit with an error code
+        unsigned int address;
+        std::istringstream(argv[mappedFiles[i] + 1]) >> std::hex >> address;
+        if (!dataMemory.mapFile(address, argv[mappedFiles[i] + 2]))
+        {
+            std::cerr << "Error: Unable to map " << argv[mappedFiles[i] + 2] << std::endl;
+            return 1;
+        }
     }
+    Cpu cpu(image, dataMemory, registerFile);
+    cpu.setForwardingLog(logForwarding);
+
+    // the trace is written to the standard output by a background thread
+    TraceSink trace(stdout);
+    cpu.setTraceSink(&trace);
 
-    std::string line;
-    while (std::getline(inputFile, line))
+    // each cycle can also be recorded to a binary trace, which
+    // tracedump prints in the format of Cpu::dump
+    BinaryTraceWriter binaryTrace;
+    if (binaryTraceFile)
     {
-        // Parse the line into instruction address, instruction type, and instruction value
-        unsigned int address, type, value;
-        std::istringstream iss(line);
-        iss >> std::hex >> address >> type >> value;
+        if (!binaryTrace.open(binaryTraceFile))
+        {
+            std::cerr << "Error: Unable to create " << binaryTraceFile << std::endl;
+            return 1;
+        }
+        cpu.setBinaryTrace(&binaryTrace);
+    }
+    Profiler profiler;
+    if (!profileName.empty())
+        cpu.setProfiler(&profiler);
 
-        // Store the instruction in instruction memory
-        instructionMemory.setAt(address, value);
+    // the counters are written one JSON object per line
+    std::ofstream counters;
+    if (countersFile)
+    {
+        counters.open(countersFile);
+        if (!counters)
+        {
+            std::cerr << "Error: Unable to create " << countersFile << std::endl;
+            return 1;
+        }
     }
 
     // Simulate the fetch-decode-execute cycle using the Cpu class
     for (unsigned int cycle = 0; cycle < numCycles; ++cycle)
     {
         // Print the current clock cycle
-        std::cout << "Clock Cycle: " << cycle << std::endl;
-
-        // Fetch instruction from instruction memory
-        unsigned int pc = cycle * 4;
-        unsigned int instruction = instructionMemory.value(pc);
-
-        // Set the program counter using the Cpu's setImem function
-        cpu.setImem(pc, instruction);
+        trace << "Clock Cycle: " << cycle << "\n";
 
         // Update the Cpu for one clock cycle
         cpu.update();
+        if (countersFile && countersInterval && (cpu.getClockCycle() % countersInterval == 0))
+            cpu.writeCounters(counters);
 
-        // Check if the program has finished (reached the "done:" instruction)
-        if (cpu.getPC() == 0x88)
+        // Check if the program has finished (reached the "done:" loop or a break)
+        if (cpu.isHalted())
         {
-            std::cout << "Program finished at clock cycle " << cycle << std::endl;
+            trace << "Program finished at clock cycle " << cycle << "\n";
             break;
         }
 
         // Optionally, print the state of the Cpu (uncomment if needed)
-        // cpu.dump();
+        // cpu.dump(trace);
     }
 
     // Print the final state of the register file using the Cpu's dump function
-    std::cout << "Final Register File State:" << std::endl;
-    cpu.dump();
+    trace << "Final Register File State:\n";
+    cpu.dump(trace);
 
+    if (countersFile)
+    {
+        if (!countersInterval || (cpu.getClockCycle() % countersInterval != 0))
+            cpu.writeCounters(counters);
+        counters.close();
+        if (!counters)
+        {
+            std::cerr << "Error: Unable to write " << countersFile << std::endl;
+            return 1;
+        }
+    }
+    if (binaryTraceFile && !binaryTrace.close())
+    {
+        std::cerr << "Error: Unable to write " << binaryTraceFile << std::endl;
+        return 1;
+    }
+    if (!profileName.empty())
+    {
+        std::ofstream report((profileName + ".txt").c_str());
+        profiler.writeReport(report);
+        std::ofstream folded((profileName + ".folded").c_str());
+        profiler.writeFolded(folded, filename.c_str());
+        if (!report || !folded)
+        {
+            std::cerr << "Error: Unable to write the profile " << profileName << std::endl;
+            return 1;
+        }
+    }
     return 0;
 }